@@ -0,0 +1,211 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "bench.h"
+#include "apu.h"
+#include "blip.h"
+#include "apulog.h"
+
+// Every case is measured alternately in rounds of frames, keeping the fastest round of each to reduce noise
+#define APU_ROUNDS 20
+#define APU_FRAMES 30
+#define APU_FRAMECYCLES 29781
+#define APU_ACCESSES 8 // Times the APU is caught up during a frame, as if the CPU accessed its registers
+#define APU_EQUIV_FRAMES 600
+#define APU_EQUIV_GAP 2000 // Most CPU cycles between two accesses
+#define APU_EQUIV_SEED 1
+#define APU_EQUIV_FRAMESAMPLES 1024 // Most samples a frame can have (about 800 at 48 kHz)
+
+// All four channels playing notes that don't stop by themselves (length counters halted, constant volume)
+const uint8_t apuBenchWrites[][2] = {
+	{0x15, 0x0F},
+	{0x00, 0xBF}, {0x02, 0xFE}, {0x03, 0x00},
+	{0x04, 0x7F}, {0x06, 0x7C}, {0x07, 0x01},
+	{0x08, 0xFF}, {0x0A, 0x00}, {0x0B, 0x02},
+	{0x0C, 0x3F}, {0x0E, 0x04}, {0x0F, 0x00}
+};
+
+int benchAPU(void) {
+	static Blip blip;
+	static float samples[BLIP_SIZE];
+	APU apu;
+
+	// Indexed by [playing][caught up]
+	double cycleTime[2][2] = {{1e9, 1e9}, {1e9, 1e9}};
+	for (int round = 0; round < APU_ROUNDS; round++) {
+		for (int playing = 0; playing < 2; playing++) {
+			for (int lazy = 0; lazy < 2; lazy++) {
+				initAPU(&apu);
+				initBlip(&blip, 1789773.0, 48000);
+				setBlipAPU(&apu, &blip);
+				if (playing) {
+					for (size_t i = 0; i < sizeof(apuBenchWrites) / sizeof(apuBenchWrites[0]); i++)
+						writeRegisterAPU(&apu, 0x4000 | apuBenchWrites[i][0], apuBenchWrites[i][1]);
+				}
+
+				const double start = benchTime();
+				for (int i = 0; i < APU_FRAMES; i++) {
+					const uint64_t frameStart = apu.clock;
+					if (lazy) {
+						for (int access = 1; access <= APU_ACCESSES; access++)
+							runAPU(&apu, frameStart + APU_FRAMECYCLES * access / APU_ACCESSES);
+					} else {
+						for (int cycle = 0; cycle < APU_FRAMECYCLES; cycle++)
+							tickAPU(&apu);
+					}
+					endFrameAPU(&apu, frameStart + APU_FRAMECYCLES);
+					readSamplesBlip(&blip, samples, BLIP_SIZE);
+				}
+				const double elapsed = (benchTime() - start) / APU_FRAMES / APU_FRAMECYCLES;
+				if (elapsed < cycleTime[playing][lazy])
+					cycleTime[playing][lazy] = elapsed;
+			}
+		}
+	}
+
+	printf("\tsilent, every cycle          %6.2f ns/cycle\n", cycleTime[0][0] * 1e9);
+	printf("\tsilent, caught up            %6.2f ns/cycle\n", cycleTime[0][1] * 1e9);
+	printf("\tfour channels, every cycle   %6.2f ns/cycle\n", cycleTime[1][0] * 1e9);
+	printf("\tfour channels, caught up     %6.2f ns/cycle\n", cycleTime[1][1] * 1e9);
+
+	return 0;
+}
+
+// The same random register accesses go to an APU ticked every cycle and to one caught up with runAPU, as the emulator does, and both must produce exactly the same samples and IRQs
+// They also go to a shadow APU logging them for an APULog, as when sound is synthesized on the audio thread, whose replayed samples must be the same too
+static bool compareAPUs(const APU *ticked, const APU *caughtUp, uint64_t cycle, const char *when) {
+	if (ticked->irqOutFrame == caughtUp->irqOutFrame && ticked->irqOutDMC == caughtUp->irqOutDMC)
+		return true;
+	printf("\tError : IRQs differ %s on cycle %llu (frame %i / %i, DMC %i / %i)\n", when, (unsigned long long)cycle, ticked->irqOutFrame, caughtUp->irqOutFrame, ticked->irqOutDMC, caughtUp->irqOutDMC);
+	return false;
+}
+
+// Samples replayed from the log on its audio thread, appended frame after frame, and only looked at once the log is terminated
+typedef struct ReplayedSamples {
+	float *samples;
+	uint64_t count;
+	bool overflow;
+} ReplayedSamples;
+
+static void appendReplayed(void *userData, Blip *blip) {
+	ReplayedSamples *replayed = (ReplayedSamples *)userData;
+	const uint64_t room = (uint64_t)APU_EQUIV_FRAMES * APU_EQUIV_FRAMESAMPLES - replayed->count;
+	if (samplesAvailableBlip(blip) > room)
+		replayed->overflow = true;
+	replayed->count += readSamplesBlip(blip, &replayed->samples[replayed->count], room < BLIP_SIZE ? room : BLIP_SIZE);
+}
+
+// Runs the random accesses, and appends the samples of the ticked APU to expected
+static int runEquivalence(APU *ticked, APU *caughtUp, APU *logged, float *expected, uint64_t *samples, uint64_t *accesses) {
+	static float tickedSamples[BLIP_SIZE], caughtUpSamples[BLIP_SIZE];
+	srand(APU_EQUIV_SEED);
+	uint64_t cycle = 0;
+	uint64_t nextAccess = rand() % APU_EQUIV_GAP;
+	for (int frame = 0; frame < APU_EQUIV_FRAMES; frame++) {
+		const uint64_t frameEnd = cycle + APU_FRAMECYCLES;
+		for (; cycle < frameEnd; cycle++) {
+			// The emulator only catches up when the frame IRQ is due, so it must be seen on the same cycle
+			if (cycle >= caughtUp->irqClock)
+				runAPU(caughtUp, cycle);
+			if (cycle >= logged->irqClock)
+				runAPU(logged, cycle);
+			if (!compareAPUs(ticked, caughtUp, cycle, "between accesses") || !compareAPUs(ticked, logged, cycle, "between accesses (shadow)"))
+				return -0x01;
+
+			if (cycle == nextAccess) {
+				runAPU(caughtUp, cycle);
+				runAPU(logged, cycle);
+				const uint8_t action = rand() % 8;
+				if (action == 0) {
+					// Reading the status also acknowledges the frame IRQ
+					const uint8_t status = readRegisterAPU(ticked, 0x4015);
+					if (readRegisterAPU(caughtUp, 0x4015) != status || readRegisterAPU(logged, 0x4015) != status) {
+						printf("\tError : status differs on cycle %llu\n", (unsigned long long)cycle);
+						return -0x01;
+					}
+				} else if (action == 1) {
+					// Frame counter mode and IRQ inhibit, mostly in the 4-step mode with IRQs so they happen
+					const uint8_t mode = (rand() % 4 == 0) ? (rand() & 0b11000000) : 0x00;
+					writeRegisterAPU(ticked, 0x4017, mode);
+					writeRegisterAPU(caughtUp, 0x4017, mode);
+					writeRegisterAPU(logged, 0x4017, mode);
+				} else {
+					const uint16_t address = 0x4000 | (rand() % 0x16);
+					const uint8_t data = rand();
+					writeRegisterAPU(ticked, address, data);
+					writeRegisterAPU(caughtUp, address, data);
+					writeRegisterAPU(logged, address, data);
+				}
+				if (!compareAPUs(ticked, caughtUp, cycle, "after an access") || !compareAPUs(ticked, logged, cycle, "after an access (shadow)"))
+					return -0x01;
+				(*accesses)++;
+				nextAccess = cycle + 1 + rand() % APU_EQUIV_GAP;
+			}
+			tickAPU(ticked);
+		}
+
+		endFrameAPU(ticked, frameEnd);
+		endFrameAPU(caughtUp, frameEnd);
+		endFrameAPU(logged, frameEnd);
+		if (!compareAPUs(ticked, caughtUp, cycle, "at the end of a frame") || !compareAPUs(ticked, logged, cycle, "at the end of a frame (shadow)"))
+			return -0x01;
+		const uint32_t tickedCount = readSamplesBlip(ticked->blip, tickedSamples, BLIP_SIZE);
+		const uint32_t caughtUpCount = readSamplesBlip(caughtUp->blip, caughtUpSamples, BLIP_SIZE);
+		if (tickedCount != caughtUpCount || memcmp(tickedSamples, caughtUpSamples, tickedCount * sizeof(float)) != 0) {
+			printf("\tError : samples differ in frame %i\n", frame);
+			return -0x01;
+		}
+		if (tickedCount > APU_EQUIV_FRAMESAMPLES) {
+			printf("\tError : frame %i has more than %i samples\n", frame, APU_EQUIV_FRAMESAMPLES);
+			return -0x02;
+		}
+		memcpy(&expected[*samples], tickedSamples, tickedCount * sizeof(float));
+		*samples += tickedCount;
+	}
+	return 0;
+}
+
+int benchAPUEquivalence(void) {
+	static Blip tickedBlip, caughtUpBlip;
+	static APULog log;
+	APU ticked, caughtUp, logged;
+	initAPU(&ticked);
+	initAPU(&caughtUp);
+	initAPU(&logged);
+	initBlip(&tickedBlip, 1789773.0, 48000);
+	initBlip(&caughtUpBlip, 1789773.0, 48000);
+	setBlipAPU(&ticked, &tickedBlip);
+	setBlipAPU(&caughtUp, &caughtUpBlip);
+
+	float *expected = malloc((size_t)APU_EQUIV_FRAMES * APU_EQUIV_FRAMESAMPLES * sizeof(float));
+	ReplayedSamples replayed = {malloc((size_t)APU_EQUIV_FRAMES * APU_EQUIV_FRAMESAMPLES * sizeof(float)), 0, false};
+	if (expected == NULL || replayed.samples == NULL || initAPULog(&log, 1789773.0, 48000, appendReplayed, &replayed) != 0) {
+		printf("\tError : couldn't set up the APU log.\n");
+		free(expected);
+		free(replayed.samples);
+		return -0x03;
+	}
+	setLogAPU(&logged, &log);
+
+	uint64_t samples = 0, accesses = 0;
+	int status = runEquivalence(&ticked, &caughtUp, &logged, expected, &samples, &accesses);
+	// Everything logged is replayed before terminating returns
+	terminateAPULog(&log);
+	if (status == 0 && (replayed.overflow || replayed.count != samples)) {
+		printf("\tError : %llu samples replayed from the log instead of %llu\n", (unsigned long long)replayed.count, (unsigned long long)samples);
+		status = -0x04;
+	}
+	for (uint64_t i = 0; status == 0 && i < samples; i++) {
+		if (replayed.samples[i] != expected[i]) {
+			printf("\tError : samples replayed from the log differ from sample %llu\n", (unsigned long long)i);
+			status = -0x05;
+		}
+	}
+	if (status == 0)
+		printf("\t%i frames, %llu accesses, %llu samples identical, also when replayed from the log\n", APU_EQUIV_FRAMES, (unsigned long long)accesses, (unsigned long long)samples);
+
+	free(expected);
+	free(replayed.samples);
+	return status;
+}
\ No newline at end of file
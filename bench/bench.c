@@ -0,0 +1,59 @@
+#include <stdbool.h>
+#include <string.h>
+
+#include "bench.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <time.h>
+#endif
+
+typedef struct Benchmark {
+	const char *name;
+	int (*run)(void);
+} Benchmark;
+
+const Benchmark benchmarks[] = {
+	{"compose", benchCompose},
+	{"renderskip", benchRenderSkip},
+	{"raster", benchRaster},
+	{"ppu", benchPPU},
+	{"apu", benchAPU},
+	{"resample", benchResample},
+	{"alias", benchAlias},
+	{"apu-equiv", benchAPUEquivalence},
+	{"mapper-state", benchMapperState}
+};
+
+double benchTime(void) {
+#ifdef _WIN32
+	LARGE_INTEGER frequency, counter;
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+	return (double)counter.QuadPart / frequency.QuadPart;
+#else
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+#endif
+}
+
+int main(int argc, char *argv[]) {
+	// Without arguments, every benchmark is run
+	const int count = sizeof(benchmarks) / sizeof(Benchmark);
+	int status = 0;
+	for (int i = 0; i < count; i++) {
+		bool selected = (argc < 2);
+		for (int j = 1; j < argc; j++)
+			selected |= (strcmp(argv[j], benchmarks[i].name) == 0);
+
+		if (selected) {
+			printf("[%s]\n", benchmarks[i].name);
+			if (benchmarks[i].run() != 0)
+				status = -0x01;
+		}
+	}
+
+	return status;
+}
\ No newline at end of file
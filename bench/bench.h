@@ -0,0 +1,40 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "bus.h"
+#include "ppu.h"
+#include "cartridge.h"
+
+// Number of times each measured operation is repeated by default
+#define BENCH_ITERATIONS 200000
+
+// Time in seconds from an arbitrary (but fixed) point, with the best resolution available
+double benchTime(void);
+
+// A PPU alone, with a synthetic NROM cartridge and rendering enabled
+typedef struct BenchSystem {
+	Bus bus;
+	PPU ppu;
+	Cartridge cartridge;
+	uint16_t framebuffer[256 * 240];
+} BenchSystem;
+
+void initBenchSystem(BenchSystem *system);
+void freeBenchSystem(BenchSystem *system);
+void runBenchFrame(BenchSystem *system);
+
+// Benchmarks, each printing its own results and returning 0, or a negative value if a check failed
+int benchCompose(void);
+int benchRenderSkip(void);
+int benchRaster(void);
+int benchPPU(void);
+int benchAPU(void);
+int benchResample(void);
+int benchAlias(void);
+int benchAPUEquivalence(void);
+int benchMapperState(void);
+
+#endif // ifndef BENCH_H
\ No newline at end of file
@@ -0,0 +1,52 @@
+#include <stdlib.h>
+
+#include "bench.h"
+#include "ppu.h"
+#include "compose.h"
+
+int benchCompose(void) {
+	static uint16_t framebuffer[256 * 240];
+	PPU ppu;
+	initPPU(&ppu, framebuffer, NULL);
+
+	// Arbitrary but reproducible scanline contents, with every rendering option enabled
+	srand(0);
+	for (int i = 0; i < SPRLINE_SIZE; i++)
+		ppu.sprLine[i] = rand() & (SPRLINE_COLOR | SPRLINE_PALETTE | SPRLINE_PRIORITY);
+	for (int i = 0; i < 16; i++) {
+		ppu.pendingBg[i] = rand() & 0b1111;
+		ppu.pendingMask[i] = MASK_RENDERSPR | MASK_RENDERBG | MASK_SHOWLEFTSPR | MASK_SHOWLEFTBG;
+	}
+	for (int i = 0; i < 32; i++)
+		ppu.palettes[i] = rand() & 0x3F;
+	ppu.scanline = 100;
+
+	const struct {
+		const char *name;
+		ComposeFunction compose;
+	} composers[] = {
+		{"scalar", composePixelsScalar},
+		{"SSE2", composePixelsSSE2},
+		{"SSSE3", composePixelsSSSE3}
+	};
+
+	double scalarTime = 0.0f;
+	for (int i = 0; i < 3; i++) {
+		const double start = benchTime();
+		for (int j = 0; j < BENCH_ITERATIONS; j++) {
+			// A whole scanline, in batches of 16 pixels
+			for (int k = 0; k < 256; k += 16) {
+				ppu.pendingPixel = k;
+				ppu.pendingCount = 16;
+				composers[i].compose(&ppu);
+			}
+		}
+		const double elapsed = benchTime() - start;
+		if (i == 0)
+			scalarTime = elapsed;
+
+		printf("\t%-8s %6.3f ns/pixel (x%.2f)%s\n", composers[i].name, elapsed * 1e9 / BENCH_ITERATIONS / 256, scalarTime / elapsed, ppu.composePixels == composers[i].compose ? " (selected)" : "");
+	}
+
+	return 0;
+}
\ No newline at end of file
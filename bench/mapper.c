@@ -0,0 +1,119 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "bench.h"
+#include "cpu.h"
+
+#define MAPPER_STATE_ROUNDS 200
+#define MAPPER_STATE_WRITES 16 // Random writes to the registers before saving, and again before loading
+#define MAPPER_STATE_MAXSIZE 256 // Bytes, more than the state of any mapper
+#define MAPPER_STATE_PRGSIZE 0x40000
+#define MAPPER_STATE_CHRSIZE 0x20000
+#define MAPPER_STATE_SEED 1
+
+const Mapper *const benchMappers[] = {
+	&nromMapper,
+	&mmc1Mapper,
+	&mmc3Mapper,
+	&uxromMapper,
+	&cnromMapper,
+	&axromMapper,
+	&gxromMapper,
+	&colorDreamsMapper
+};
+
+// Random writes from 0x8000, as a game switching banks, with a scanline between them for mappers counting them
+static void writeRegisters(Bus *bus) {
+	const Mapper *mapper = bus->cartridge->mapper;
+	for (int i = 0; i < MAPPER_STATE_WRITES; i++) {
+		// MMC1 ignores writes on consecutive cycles, and is mostly written to one bit at a time (without the reset bit)
+		bus->cpu->cycleCount += 4;
+		const uint8_t data = (rand() % 8 == 0) ? rand() : (rand() & 0x7F);
+		mapper->writePRG(bus, 0x8000 | (rand() & 0x7FFF), data);
+		if (mapper->scanline != NULL)
+			mapper->scanline(bus);
+	}
+}
+
+static bool sameBanks(const Cartridge *a, const Cartridge *b) {
+	return memcmp(a->PRGbanks, b->PRGbanks, sizeof(a->PRGbanks)) == 0
+		&& memcmp(a->CHRbanks, b->CHRbanks, sizeof(a->CHRbanks)) == 0
+		&& memcmp(a->CHRtileBanks, b->CHRtileBanks, sizeof(a->CHRtileBanks)) == 0
+		&& memcmp(a->nametables, b->nametables, sizeof(a->nametables)) == 0
+		&& a->irqOut == b->irqOut;
+}
+
+// The state of every mapper is saved, its registers written again, and the state loaded back, which must map the same banks and set the same IRQ line as when it was saved
+int benchMapperState(void) {
+	static CPU cpu;
+	static Cartridge cart;
+	static uint8_t buffer[MAPPER_STATE_MAXSIZE];
+	Bus bus;
+	initBus(&bus, &cpu, NULL, NULL, NULL, &cart);
+
+	srand(MAPPER_STATE_SEED);
+	uint8_t *PRG = malloc(MAPPER_STATE_PRGSIZE);
+	cart.CHR = malloc(MAPPER_STATE_CHRSIZE);
+	cart.CHRtileCache = malloc(MAPPER_STATE_CHRSIZE * sizeof(uint16_t));
+	if (PRG == NULL || cart.CHR == NULL || cart.CHRtileCache == NULL) {
+		printf("\tError : couldn't allocate memory for the cartridge.\n");
+		free(PRG);
+		free(cart.CHR);
+		free(cart.CHRtileCache);
+		return -0x01;
+	}
+	// Bus conflicts AND the value written with the ROM
+	for (uint32_t i = 0; i < MAPPER_STATE_PRGSIZE; i++)
+		PRG[i] = rand();
+	cart.PRG = PRG;
+	cart.PRGsize = MAPPER_STATE_PRGSIZE;
+	cart.CHRsize = MAPPER_STATE_CHRSIZE;
+	cart.CHRisRAM = false;
+	cart.persistentRAM = NULL;
+	cart.extraVRAM = NULL;
+	cart.image = NULL;
+
+	int status = 0;
+	for (size_t i = 0; i < sizeof(benchMappers) / sizeof(benchMappers[0]) && status == 0; i++) {
+		const Mapper *mapper = benchMappers[i];
+		if (mapper->stateSize > MAPPER_STATE_MAXSIZE) {
+			printf("\tError : the state of %s doesn't fit in %i bytes\n", mapper->name, MAPPER_STATE_MAXSIZE);
+			status = -0x02;
+			break;
+		}
+		cart.mapperID = mapper->id;
+		cart.irqOut = false;
+		setMirroring(&cart, MIRROR_VERTICAL);
+		if (initMapper(&cart, mapper) != 0) {
+			printf("\tError : couldn't allocate memory for the state of %s\n", mapper->name);
+			status = -0x03;
+			break;
+		}
+
+		int changed = 0;
+		for (int round = 0; round < MAPPER_STATE_ROUNDS; round++) {
+			writeRegisters(&bus);
+			const Cartridge saved = cart;
+			saveMapperState(&cart, buffer);
+
+			// Rounds where the writes didn't change anything don't check much, so they are counted
+			writeRegisters(&bus);
+			changed += !sameBanks(&cart, &saved);
+			loadMapperState(&cart, buffer);
+			if (!sameBanks(&cart, &saved)) {
+				printf("\tError : %s doesn't map the same banks or set the same IRQ line after loading the state in round %i\n", mapper->name, round);
+				status = -0x04;
+				break;
+			}
+		}
+		if (status == 0)
+			printf("\t%-14s %i rounds restored, %i of which had their banks changed before loading\n", mapper->name, MAPPER_STATE_ROUNDS, changed);
+		freeMapper(&cart);
+	}
+
+	free(PRG);
+	free(cart.CHR);
+	free(cart.CHRtileCache);
+	return status;
+}
\ No newline at end of file
@@ -0,0 +1,38 @@
+#include <stdlib.h>
+
+#include "bench.h"
+
+// Both cases are measured alternately in rounds of frames, keeping the fastest round of each to reduce noise
+#define PPU_ROUNDS 20
+#define PPU_FRAMES 30
+
+int benchPPU(void) {
+	BenchSystem *system = malloc(sizeof(BenchSystem));
+	initBenchSystem(system);
+	const uint8_t mask = system->ppu.registers[PPUMASK];
+
+	// Pixels aren't composed, so only the PPU's own work is measured
+	setRenderSkipPPU(&system->ppu, true);
+
+	double dotTime[2] = {1e9, 1e9};
+	for (int round = 0; round < PPU_ROUNDS; round++) {
+		for (int rendering = 0; rendering < 2; rendering++) {
+			writeRegisterPPU(&system->ppu, PPUMASK, rendering ? mask : 0);
+
+			const double start = benchTime();
+			for (int i = 0; i < PPU_FRAMES; i++)
+				runBenchFrame(system);
+			const double elapsed = (benchTime() - start) / PPU_FRAMES / (341 * 262);
+			if (elapsed < dotTime[rendering])
+				dotTime[rendering] = elapsed;
+		}
+	}
+
+	printf("\trendering disabled %6.2f ns/dot\n", dotTime[0] * 1e9);
+	printf("\trendering enabled  %6.2f ns/dot\n", dotTime[1] * 1e9);
+
+	freeBenchSystem(system);
+	free(system);
+
+	return 0;
+}
\ No newline at end of file
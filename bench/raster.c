@@ -0,0 +1,77 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "raster.h"
+
+#define RASTER_FRAMES 300
+
+// Time spent on the emulation thread for each frame, with pixels composed inline or by a rasterizer with the given number of workers (negative for none)
+// The resulting frame is compared with the one composed inline, and a negative value is returned if it differs or the rasterizer couldn't be started
+static int timeFrames(int threads, uint16_t *reference, double *elapsed) {
+	BenchSystem *system = malloc(sizeof(BenchSystem));
+	Rasterizer *raster = malloc(sizeof(Rasterizer));
+	if (system == NULL || raster == NULL) {
+		printf("\tError : couldn't allocate memory\n");
+		free(system);
+		free(raster);
+		return -0x01;
+	}
+
+	initBenchSystem(system);
+	if (threads >= 0) {
+		if (initRasterizer(raster, system->framebuffer, threads) != 0) {
+			printf("\tError : couldn't start a rasterizer with %i threads\n", threads);
+			freeBenchSystem(system);
+			free(system);
+			free(raster);
+			return -0x02;
+		}
+		setRasterizerPPU(&system->ppu, raster);
+	}
+
+	const double start = benchTime();
+	for (int i = 0; i < RASTER_FRAMES; i++)
+		runBenchFrame(system);
+	*elapsed = (benchTime() - start) / RASTER_FRAMES;
+
+	if (threads >= 0) {
+		waitRaster(raster);
+		setRasterizerPPU(&system->ppu, NULL);
+		terminateRasterizer(raster);
+	}
+
+	int status = 0;
+	if (threads < 0) {
+		memcpy(reference, system->framebuffer, sizeof(system->framebuffer));
+	} else if (memcmp(reference, system->framebuffer, sizeof(system->framebuffer)) != 0) {
+		printf("\tError : frame differs from inline composition with %i threads\n", threads);
+		status = -0x03;
+	}
+
+	freeBenchSystem(system);
+	free(system);
+	free(raster);
+	return status;
+}
+
+int benchRaster(void) {
+	static uint16_t reference[256 * 240];
+	double inlineTime;
+	if (timeFrames(-1, reference, &inlineTime) != 0)
+		return -0x01;
+	printf("\tinline     %8.1f us/frame\n", inlineTime * 1e6);
+
+	int status = 0;
+	const int threads[] = {0, 1, 2, 4};
+	for (int i = 0; i < 4; i++) {
+		double elapsed;
+		const int result = timeFrames(threads[i], reference, &elapsed);
+		if (result == -0x03 || result == 0)
+			printf("\t%i workers  %8.1f us/frame on the emulation thread (x%.2f)\n", threads[i], elapsed * 1e6, inlineTime / elapsed);
+		if (result != 0)
+			status = -0x01;
+	}
+
+	return status;
+}
\ No newline at end of file
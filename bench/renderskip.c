@@ -0,0 +1,35 @@
+#include <stdlib.h>
+
+#include "bench.h"
+
+// Both modes are measured alternately in rounds of frames, keeping the fastest round of each to reduce noise
+#define RENDERSKIP_ROUNDS 10
+#define RENDERSKIP_FRAMES 60
+
+int benchRenderSkip(void) {
+	BenchSystem *system = malloc(sizeof(BenchSystem));
+	initBenchSystem(system);
+
+	double frameTime[2] = {1e9, 1e9};
+	for (int round = 0; round < RENDERSKIP_ROUNDS; round++) {
+		for (int skip = 0; skip < 2; skip++) {
+			setRenderSkipPPU(&system->ppu, skip);
+
+			const double start = benchTime();
+			for (int i = 0; i < RENDERSKIP_FRAMES; i++)
+				runBenchFrame(system);
+			const double elapsed = (benchTime() - start) / RENDERSKIP_FRAMES;
+			if (elapsed < frameTime[skip])
+				frameTime[skip] = elapsed;
+		}
+	}
+
+	printf("\trendered %8.1f us/frame\n", frameTime[0] * 1e6);
+	printf("\tskipped  %8.1f us/frame\n", frameTime[1] * 1e6);
+	printf("\tsaved    %8.1f us/frame (%.1f%%)\n", (frameTime[0] - frameTime[1]) * 1e6, (frameTime[0] - frameTime[1]) * 100 / frameTime[0]);
+
+	freeBenchSystem(system);
+	free(system);
+
+	return 0;
+}
@@ -0,0 +1,145 @@
+#include <math.h>
+#include <stdbool.h>
+
+#include "bench.h"
+#include "resample.h"
+
+#define RESAMPLE_INPUTRATE (1789773.0 / 32) // Rate sound is synthesized at
+#define RESAMPLE_FRAME 932 // Input samples in a frame
+#define RESAMPLE_ROUNDS 10
+#define RESAMPLE_FRAMES 60
+
+// The sweep goes through the whole input band, a tone at a time
+#define ALIAS_STEP 250.0 // Hz between two tones
+#define ALIAS_SAMPLES 8192 // Input samples of each tone
+#define ALIAS_PASSBAND 16000.0 // Tones up to this frequency must come out untouched, between it and the output Nyquist frequency is the transition band
+// Beyond these, the sweep fails
+#define ALIAS_MAXRIPPLE 0.01 // dB, either way
+#define ALIAS_MAXSTOPBAND -70.0 // dB
+
+const double resampleRates[] = {44100, 48000, 96000};
+
+// Resamples a pure tone, and returns the power of what came out, relative to the input tone: as the tone itself (gain), and as anything else (aliases and images)
+// Tones past the output Nyquist frequency have nothing to come out as, so everything is counted as aliases
+void resampleTone(Resampler *resampler, double frequency, double *gain, double *aliases) {
+	static float in[ALIAS_SAMPLES], out[2 * ALIAS_SAMPLES];
+	const double pi = 3.14159265358979323846;
+	for (int i = 0; i < ALIAS_SAMPLES; i++)
+		in[i] = (float)(0.5 * sin(2 * pi * frequency / RESAMPLE_INPUTRATE * i));
+
+	clearResampler(resampler);
+	writeResampler(resampler, in, ALIAS_SAMPLES);
+	const uint32_t count = readResampler(resampler, out, 2 * ALIAS_SAMPLES);
+
+	// Least squares fit of the tone at its frequency in the output (its phase depends on the delay of the filter)
+	const double omega = 2 * pi * frequency * resampler->step / RESAMPLE_INPUTRATE;
+	double cc = 0, ss = 0, cs = 0, xc = 0, xs = 0;
+	for (uint32_t i = 0; i < count; i++) {
+		const double c = cos(omega * i), s = sin(omega * i);
+		cc += c * c;
+		ss += s * s;
+		cs += c * s;
+		xc += out[i] * c;
+		xs += out[i] * s;
+	}
+	double a = 0, b = 0;
+	if (frequency < resampler->outputRate / 2) {
+		const double determinant = cc * ss - cs * cs;
+		a = (xc * ss - xs * cs) / determinant;
+		b = (xs * cc - xc * cs) / determinant;
+	}
+
+	double residual = 0;
+	for (uint32_t i = 0; i < count; i++) {
+		const double error = out[i] - a * cos(omega * i) - b * sin(omega * i);
+		residual += error * error;
+	}
+	const double inputPower = 0.5 * 0.5 / 2 * count;
+	*gain = (a * a + b * b) / 2 * count / inputPower;
+	*aliases = residual / inputPower;
+}
+
+int benchResample(void) {
+	static Resampler resampler;
+	static float in[RESAMPLE_FRAME], out[4 * RESAMPLE_FRAME];
+	const ConvolveFunction convolvers[] = {convolveScalar, convolveSSE, convolveAVX};
+	const char *names[] = {"scalar", "SSE", "AVX"};
+
+	// Anything but silence, the contents don't change the time taken
+	for (int i = 0; i < RESAMPLE_FRAME; i++)
+		in[i] = (float)sin(i * 0.05);
+
+	for (size_t rate = 0; rate < sizeof(resampleRates) / sizeof(resampleRates[0]); rate++) {
+		initResampler(&resampler, RESAMPLE_INPUTRATE, resampleRates[rate]);
+		const ConvolveFunction selected = resampler.convolve;
+
+		double scalarTime = 0;
+		for (int i = 0; i < 3; i++) {
+			resampler.convolve = convolvers[i];
+			double sampleTime = 1e9;
+			for (int round = 0; round < RESAMPLE_ROUNDS; round++) {
+				clearResampler(&resampler);
+				uint64_t samples = 0;
+				const double start = benchTime();
+				for (int frame = 0; frame < RESAMPLE_FRAMES; frame++) {
+					writeResampler(&resampler, in, RESAMPLE_FRAME);
+					samples += readResampler(&resampler, out, 4 * RESAMPLE_FRAME);
+				}
+				const double elapsed = (benchTime() - start) / samples;
+				if (elapsed < sampleTime)
+					sampleTime = elapsed;
+			}
+			if (i == 0)
+				scalarTime = sampleTime;
+
+			printf("\t%5.1f kHz %-8s %6.2f ns/sample (x%.2f)%s\n", resampleRates[rate] / 1000, names[i], sampleTime * 1e9, scalarTime / sampleTime, selected == convolvers[i] ? " (selected)" : "");
+		}
+	}
+
+	return 0;
+}
+
+// Sine sweep through the resampler at each output rate: every tone in the passband must keep its level without anything else coming out, and every tone past the output Nyquist frequency (which would alias back into the audible band) must be gone
+int benchAlias(void) {
+	static Resampler resampler;
+	int status = 0;
+	for (size_t rate = 0; rate < sizeof(resampleRates) / sizeof(resampleRates[0]); rate++) {
+		initResampler(&resampler, RESAMPLE_INPUTRATE, resampleRates[rate]);
+
+		double minGain = 1, maxGain = 1, worstPassband = 1e-20, worstStopband = 1e-20;
+		bool stopband = false;
+		for (double frequency = ALIAS_STEP; frequency < RESAMPLE_INPUTRATE / 2; frequency += ALIAS_STEP) {
+			double gain, aliases;
+			resampleTone(&resampler, frequency, &gain, &aliases);
+			if (frequency <= ALIAS_PASSBAND) {
+				if (gain < minGain)
+					minGain = gain;
+				if (gain > maxGain)
+					maxGain = gain;
+				if (aliases > worstPassband)
+					worstPassband = aliases;
+			} else if (frequency >= resampleRates[rate] / 2) {
+				stopband = true;
+				if (aliases > worstStopband)
+					worstStopband = aliases;
+			}
+		}
+
+		printf("\t%5.1f kHz passband ripple %+.4f / %+.4f dB, worst alias in passband %6.1f dB", resampleRates[rate] / 1000, 10 * log10(minGain), 10 * log10(maxGain), 10 * log10(worstPassband));
+		if (stopband)
+			printf(", worst alias from stopband %6.1f dB\n", 10 * log10(worstStopband));
+		else
+			printf(", no tone past the output Nyquist frequency\n");
+
+		if (-10 * log10(minGain) > ALIAS_MAXRIPPLE || 10 * log10(maxGain) > ALIAS_MAXRIPPLE) {
+			printf("\tError : passband ripple over %.2f dB\n", ALIAS_MAXRIPPLE);
+			status = -0x01;
+		}
+		if (stopband && 10 * log10(worstStopband) > ALIAS_MAXSTOPBAND) {
+			printf("\tError : alias from stopband over %.1f dB\n", ALIAS_MAXSTOPBAND);
+			status = -0x01;
+		}
+	}
+
+	return status;
+}
\ No newline at end of file
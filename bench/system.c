@@ -0,0 +1,50 @@
+#include <stdlib.h>
+
+#include "bench.h"
+
+void initBenchSystem(BenchSystem *system) {
+	// An NROM cartridge with arbitrary (but reproducible) pattern tables and nametables
+	srand(0);
+	Cartridge *cart = &system->cartridge;
+	cart->mapperID = MAPPER_NROM;
+	cart->extraVRAM = NULL;
+	cart->irqOut = false;
+	setMirroring(cart, MIRROR_VERTICAL);
+	cart->PRG = cart->persistentRAM = NULL;
+	cart->image = NULL;
+	cart->PRGsize = 0;
+	cart->CHRisRAM = false;
+	cart->CHRsize = 0x2000;
+	cart->CHR = malloc(cart->CHRsize);
+	cart->CHRtileCache = malloc(cart->CHRsize * sizeof(uint16_t));
+	for (uint32_t i = 0; i < cart->CHRsize; i++)
+		cart->CHR[i] = rand();
+	for (uint32_t i = 0; i < cart->CHRsize / 2; i++)
+		decodeTileRow(cart, i);
+	initMapper(cart, &nromMapper);
+	for (int i = 0; i < 0x0800; i++)
+		cart->internalVRAM[i] = rand();
+
+	// Only the PPU is emulated, as if the CPU had set it up during VBlank
+	initBus(&system->bus, NULL, &system->ppu, NULL, NULL, cart);
+	initPPU(&system->ppu, system->framebuffer, &system->bus);
+	for (int i = 0; i < 256; i++)
+		system->ppu.OAM[i] = rand();
+	for (int i = 0; i < 32; i++)
+		system->ppu.palettes[i] = rand() & 0x3F;
+	writeRegisterPPU(&system->ppu, PPUCTRL, CTRL_SPRPATTERN);
+	writeRegisterPPU(&system->ppu, PPUMASK, MASK_RENDERSPR | MASK_RENDERBG | MASK_SHOWLEFTSPR | MASK_SHOWLEFTBG);
+}
+
+void freeBenchSystem(BenchSystem *system) {
+	free(system->cartridge.CHR);
+	free(system->cartridge.CHRtileCache);
+	freeMapper(&system->cartridge);
+}
+
+void runBenchFrame(BenchSystem *system) {
+	// Odd frames are one dot shorter when rendering
+	const int dots = 341 * 262 - system->ppu.oddFrame;
+	for (int i = 0; i < dots; i++)
+		tickPPU(&system->ppu);
+}
@@ -1,6 +1,9 @@
 #include "apu.h"
+#include "apulog.h"
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
 // Undefined later
 #define FRAMECOUNTER_5STEP(apu) ((apu)->registers[APU_FRAMECOUNTER] & 0b10000000)
@@ -12,6 +15,7 @@
 #define SQUARE1PERIOD(apu) (((uint16_t)(apu)->registers[APU_SQUARE1_COUNTER_TIMERHIGH] & 0b00000111) << 8 | (apu)->registers[APU_SQUARE1_TIMERLOW])
 #define SQUARE2PERIOD(apu) (((uint16_t)(apu)->registers[APU_SQUARE2_COUNTER_TIMERHIGH] & 0b00000111) << 8 | (apu)->registers[APU_SQUARE2_TIMERLOW])
 #define TRIANGLEPERIOD(apu) (((uint16_t)(apu)->registers[APU_TRIANGLE_TIMERHIGH] & 0b00000111) << 8 | (apu)->registers[APU_TRIANGLE_TIMERLOW])
+#define SHADOW(apu) ((apu)->blip == NULL) // Nothing is output, so only what the CPU can observe has to run
 
 const uint8_t lengthCounterLookup[0x20] = {
 	0x0A, 0xFE, 0x14, 0x02, 0x28, 0x04, 0x50, 0x06, 0xA0, 0x08, 0x3C, 0x0A, 0x0E, 0x0C, 0x1A, 0x0E,
@@ -35,11 +39,12 @@ const bool squareWaveform[4][8] = {
 };
 
 // Non-interface functions
-float mixChannels(APU *apu, uint8_t square1In, uint8_t square2In, uint8_t triangleIn, uint8_t noiseIn, uint8_t DMCIn) {
+// The output is between 0 and 1, returned in units of 1 / BLIP_AMPLITUDE
+int32_t mixChannels(APU *apu, uint8_t square1In, uint8_t square2In, uint8_t triangleIn, uint8_t noiseIn, uint8_t DMCIn) {
 	double squareOut = apu->squareMixerLookup[square1In + square2In];
 	double tndOut = apu->tndMixerLookup[3 * triangleIn + 2 * noiseIn + DMCIn];
 	double output = squareOut + tndOut;
-	return output;
+	return (int32_t)(output * BLIP_AMPLITUDE + 0.5);
 }
 
 void clockLengthCounters(APU *apu) {
@@ -138,6 +143,153 @@ uint8_t envelopeVolume(uint8_t envelopeRegister, uint8_t envelopeCounter) {
 	return volume;
 }
 
+void clockFrameCounter(APU *apu) {
+	apu->frameCounterDivider++;
+	if (apu->frameCounterDivider >= 28828 && !(apu->registers[APU_FRAMECOUNTER] & 0b01000000) && !FRAMECOUNTER_5STEP(apu)) {
+		apu->irqOutFrame = true;
+	}
+	if (apu->frameCounterDivider == 14913) {
+		clockLengthCounters(apu);
+		clockSweepUnits(apu);
+	}
+	if (apu->frameCounterDivider == 7457 || apu->frameCounterDivider == 14913 || apu->frameCounterDivider == 22371) {
+		clockLinearCounter(apu);
+		clockEnvelopes(apu);
+	}
+	if ((apu->frameCounterDivider == 29829 && !FRAMECOUNTER_5STEP(apu)) || (apu->frameCounterDivider == 37281 && FRAMECOUNTER_5STEP(apu))) {
+		clockLinearCounter(apu);
+		clockEnvelopes(apu);
+		clockLengthCounters(apu);
+		clockSweepUnits(apu);
+		apu->frameCounterDivider = 0;
+	}
+}
+
+void clockNoiseShiftRegister(APU *apu) {
+	bool feedback = apu->noiseShiftRegister & 1;
+	if (apu->registers[APU_NOISE_PERIOD] & 0b10000000) {
+		feedback ^= (apu->noiseShiftRegister >> 6) & 1;
+	} else {
+		feedback ^= (apu->noiseShiftRegister >> 1) & 1;
+	}
+	apu->noiseShiftRegister >>= 1;
+	apu->noiseShiftRegister |= (feedback << 13);
+}
+
+// Counts a timer clocked every cycle down for the given number of cycles, reloading it as tickAPU would, and returns how many times it reached 0 (stepping the waveform)
+// Once reloaded, the timer reaches 0 again every reload cycles, so whole periods are skipped at once
+uint64_t advanceTimer(uint16_t *timer, uint16_t reload, uint64_t cycles) {
+	if ((uint64_t)*timer + 1 > cycles) {
+		*timer -= cycles;
+		return 0;
+	}
+	cycles -= (uint64_t)*timer + 1;
+	const uint64_t steps = 1 + cycles / reload;
+	*timer = reload - 1 - cycles % reload;
+	return steps;
+}
+
+// Same as advanceTimer, for the timers of the square channels, only clocked on cycles where the divider is odd
+// The divider given is the one before those cycles, and mustn't wrap around during them
+uint64_t advanceSquareTimer(uint16_t *timer, uint16_t reload, uint64_t divider, uint64_t cycles) {
+	uint64_t steps = 0;
+	while (true) {
+		const uint64_t untilZero = *timer == 0 ? 1 : 2 * (uint64_t)*timer + (divider & 1);
+		if (untilZero > cycles)
+			break;
+		divider += untilZero;
+		cycles -= untilZero;
+		steps++;
+		// Reloaded on an odd cycle, the timer is also clocked right away; after at most two reloads, they all happen on even cycles, every 2 * reload cycles
+		*timer = reload - (divider & 1);
+		if ((divider & 1) == 0) {
+			const uint64_t periods = cycles / (2 * (uint64_t)reload);
+			steps += periods;
+			cycles -= periods * 2 * reload;
+		}
+	}
+	*timer -= (divider + cycles + 1) / 2 - (divider + 1) / 2;
+	return steps;
+}
+
+// Number of cycles until the next one where the output may change: a step of the frame counter, or a timer stepping the waveform of a channel that can be heard
+// Cycles before it can be skipped all at once (see skipCycles)
+uint64_t cyclesToNextEvent(const APU *apu) {
+	const uint32_t divider = apu->frameCounterDivider;
+	const uint32_t steps[4] = {7457, 14913, 22371, FRAMECOUNTER_5STEP(apu) ? 37281 : 29829};
+	uint64_t next = UINT64_MAX;
+	for (int i = 0; i < 4; i++) {
+		// The divider only wraps around at 2^32 when it went past the last step (after switching modes)
+		uint64_t untilStep = (uint64_t)(uint32_t)(steps[i] - divider - 1) + 1;
+		if (untilStep < next)
+			next = untilStep;
+	}
+	// A shadow only runs its frame counter
+	if (SHADOW(apu))
+		return next;
+
+	// Channels that are muted or silent have timers running all the same, but their output stays at 0 whatever their waveform
+	// As the divider doesn't wrap around before the next step of the frame counter, square timers are clocked every second cycle
+	uint16_t square1Period = SQUARE1PERIOD(apu);
+	bool square1Silent = (square1Period < 8) || (targetSweepPeriod(apu->registers[APU_SQUARE1_SWEEP], square1Period, false) > 0x7FF) || (apu->square1LengthCounter == 0) || envelopeVolume(apu->registers[APU_SQUARE1_ENVELOPE_MISC], apu->square1EnvelopeVolumeCounter) == 0;
+	if (!square1Silent) {
+		uint64_t untilSquare1 = apu->square1PeriodTimer == 0 ? 1 : 2 * (uint64_t)apu->square1PeriodTimer + (divider & 1);
+		next = untilSquare1 < next ? untilSquare1 : next;
+	}
+	uint16_t square2Period = SQUARE2PERIOD(apu);
+	bool square2Silent = (square2Period < 8) || (targetSweepPeriod(apu->registers[APU_SQUARE2_SWEEP], square2Period, true) > 0x7FF) || (apu->square2LengthCounter == 0) || envelopeVolume(apu->registers[APU_SQUARE2_ENVELOPE_MISC], apu->square2EnvelopeVolumeCounter) == 0;
+	if (!square2Silent) {
+		uint64_t untilSquare2 = apu->square2PeriodTimer == 0 ? 1 : 2 * (uint64_t)apu->square2PeriodTimer + (divider & 1);
+		next = untilSquare2 < next ? untilSquare2 : next;
+	}
+	// The triangle's waveform only steps when both its counters are non-zero
+	if (apu->triangleLengthCounter > 0 && apu->triangleLinearCounter > 0) {
+		uint64_t untilTriangle = (uint64_t)apu->trianglePeriodTimer + 1;
+		next = untilTriangle < next ? untilTriangle : next;
+	}
+	if (apu->noiseLengthCounter != 0 && envelopeVolume(apu->registers[APU_NOISE_ENVELOPE], apu->noiseEnvelopeVolumeCounter) != 0) {
+		uint64_t untilNoise = (uint64_t)apu->noisePeriodTimer + 1;
+		next = untilNoise < next ? untilNoise : next;
+	}
+	return next;
+}
+
+// Runs the cycles before the next event (see cyclesToNextEvent) all at once: timers advance by whole periods, and the waveforms of silent channels step without being output
+void skipCycles(APU *apu, uint64_t cycles) {
+	if (cycles == 0)
+		return;
+
+	const uint64_t divider = apu->frameCounterDivider;
+	apu->frameCounterDivider += cycles;
+	if (apu->frameCounterDivider >= 28828 && !(apu->registers[APU_FRAMECOUNTER] & 0b01000000) && !FRAMECOUNTER_5STEP(apu)) {
+		apu->irqOutFrame = true;
+	}
+	apu->clock += cycles;
+	if (SHADOW(apu))
+		return;
+
+	apu->square1WaveformSequencer += advanceSquareTimer(&apu->square1PeriodTimer, SQUARE1PERIOD(apu) + 1, divider, cycles);
+	apu->square2WaveformSequencer += advanceSquareTimer(&apu->square2PeriodTimer, SQUARE2PERIOD(apu) + 1, divider, cycles);
+	uint64_t triangleSteps = advanceTimer(&apu->trianglePeriodTimer, TRIANGLEPERIOD(apu) + 1, cycles);
+	if (apu->triangleLengthCounter > 0 && apu->triangleLinearCounter > 0) {
+		apu->triangleWaveformSequencer += triangleSteps;
+	}
+	for (uint64_t noiseSteps = advanceTimer(&apu->noisePeriodTimer, noisePeriodLookup[apu->registers[APU_NOISE_PERIOD] & 0b1111] + 1, cycles); noiseSteps > 0; noiseSteps--) {
+		clockNoiseShiftRegister(apu);
+	}
+}
+
+// The frame IRQ is the only output of the APU that has to be known on time, which is why it is predicted
+void predictFrameIRQ(APU *apu) {
+	if (apu->irqOutFrame || (apu->registers[APU_FRAMECOUNTER] & 0b01000000) || FRAMECOUNTER_5STEP(apu)) {
+		apu->irqClock = UINT64_MAX;
+	} else if (apu->frameCounterDivider + 1 >= 28828) {
+		apu->irqClock = apu->clock + 1;
+	} else {
+		apu->irqClock = apu->clock + 28828 - apu->frameCounterDivider;
+	}
+}
+
 // Interface functions
 void initAPU(APU *apu) {
 	for (int i = 0; i < 0x18; i++) {
@@ -149,8 +301,9 @@ void initAPU(APU *apu) {
 	apu->square1LengthCounter = apu->square2LengthCounter = apu->triangleLengthCounter = apu->noiseLengthCounter = 0;
 	apu->square1SweepDivider = apu->square2SweepDivider = 0;
 	apu->reloadSquare1Sweep = apu->reloadSquare2Sweep = false;
-	apu->square1EnvelopeVolumeCounter = apu->square2EnvelopeVolumeCounter = apu->square1EnvelopeDivider = apu->square2EnvelopeDivider = 0;
-	apu->square1RestartEnvelope = apu->square2RestartEnvelope = false;
+	apu->square1EnvelopeVolumeCounter = apu->square2EnvelopeVolumeCounter = apu->noiseEnvelopeVolumeCounter = 0;
+	apu->square1EnvelopeDivider = apu->square2EnvelopeDivider = apu->noiseEnvelopeDivider = 0;
+	apu->square1RestartEnvelope = apu->square2RestartEnvelope = apu->noiseRestartEnvelope = false;
 	apu->square1PeriodTimer = apu->square2PeriodTimer = apu->trianglePeriodTimer = apu->noisePeriodTimer = 0;
 	apu->square1WaveformSequencer = apu->square2WaveformSequencer = 0;
 	apu->triangleLinearCounter = 0;
@@ -167,7 +320,14 @@ void initAPU(APU *apu) {
 		apu->tndMixerLookup[i] = 163.67f / (24329.0f / i + 100);
 	}
 
-	apu->currentSample = 0.0f;
+	apu->square1Output = apu->square2Output = apu->triangleOutput = apu->noiseOutput = apu->DMCOutput = 0;
+	apu->mixedOutput = 0;
+	apu->blip = NULL;
+	apu->log = NULL;
+	apu->clock = apu->frameStart = 0;
+	// The triangle doesn't output 0 on power-up
+	apu->outputStale = true;
+	predictFrameIRQ(apu);
 }
 
 uint8_t readRegisterAPU(APU *apu, uint16_t address) {
@@ -181,6 +341,7 @@ uint8_t readRegisterAPU(APU *apu, uint16_t address) {
 		bool frameInterrupt = apu->irqOutFrame;
 		bool DMCInterrupt = apu->irqOutDMC;
 		apu->irqOutFrame = false;
+		predictFrameIRQ(apu);
 		// TODO if read the same cycle it is set, do not clear the flags
 		return (square1On) | (square2On << 1) | (triangleOn << 2) | (noiseOn << 3) | (dmcOn << 4) | (frameInterrupt << 6) | (DMCInterrupt << 7);
 	}
@@ -188,7 +349,10 @@ uint8_t readRegisterAPU(APU *apu, uint16_t address) {
 }
 
 void writeRegisterAPU(APU *apu, uint16_t address, uint8_t data) {
+	if (apu->log != NULL)
+		logWriteAPU(apu->log, apu->clock, address, data);
 	apu->registers[address & 0x1F] = data;
+	apu->outputStale = true;
 	switch (address & 0x1F) {
 		case 0x01:
 			apu->reloadSquare1Sweep = true;
@@ -241,28 +405,13 @@ void writeRegisterAPU(APU *apu, uint16_t address, uint8_t data) {
 			apu->irqOutDMC = false;
 			break;
 	}
+	predictFrameIRQ(apu);
 }
 
+// Runs a single cycle
+// Registers are read and written at the current clock, so callers must first catch up with runAPU
 void tickAPU(APU *apu) {
-	apu->frameCounterDivider++;
-	if (apu->frameCounterDivider >= 28828 && !(apu->registers[APU_FRAMECOUNTER] & 0b01000000) && !FRAMECOUNTER_5STEP(apu)) {
-		apu->irqOutFrame = true;
-	}
-	if (apu->frameCounterDivider == 14913) {
-		clockLengthCounters(apu);
-		clockSweepUnits(apu);
-	}
-	if (apu->frameCounterDivider == 7457 || apu->frameCounterDivider == 14913 || apu->frameCounterDivider == 22371) {
-		clockLinearCounter(apu);
-		clockEnvelopes(apu);
-	}
-	if ((apu->frameCounterDivider == 29829 && !FRAMECOUNTER_5STEP(apu)) || (apu->frameCounterDivider == 37281 && FRAMECOUNTER_5STEP(apu))) {
-		clockLinearCounter(apu);
-		clockEnvelopes(apu);
-		clockLengthCounters(apu);
-		clockSweepUnits(apu);
-		apu->frameCounterDivider = 0;
-	}
+	clockFrameCounter(apu);
 
 	// TODO clock noise and DMC
 	uint8_t square1Output = 0;
@@ -304,14 +453,7 @@ void tickAPU(APU *apu) {
 	// Noise channel
 	if (apu->noisePeriodTimer == 0) {
 		apu->noisePeriodTimer = noisePeriodLookup[apu->registers[APU_NOISE_PERIOD] & 0b1111] + 1;
-		bool feedback = apu->noiseShiftRegister & 1;
-		if (apu->registers[APU_NOISE_PERIOD] & 0b10000000) {
-			feedback ^= (apu->noiseShiftRegister >> 6) & 1;
-		} else {
-			feedback ^= (apu->noiseShiftRegister >> 1) & 1;
-		}
-		apu->noiseShiftRegister >>= 1;
-		apu->noiseShiftRegister |= (feedback << 13);
+		clockNoiseShiftRegister(apu);
 	}
 	// Every CPU cycle
 	apu->noisePeriodTimer--;
@@ -327,8 +469,63 @@ void tickAPU(APU *apu) {
 	noiseOutput = ((apu->noiseShiftRegister & 1) == 0) && (apu->noiseLengthCounter != 0);
 	noiseOutput *= envelopeVolume(apu->registers[APU_NOISE_ENVELOPE], apu->noiseEnvelopeVolumeCounter);
 
-	float output = mixChannels(apu, square1Output, square2Output, triangleOutput, noiseOutput, DMCOutput);
-	apu->currentSample = output;
+	// Most cycles, no channel changes its output and there is nothing to mix
+	apu->outputStale = false;
+	if (square1Output != apu->square1Output || square2Output != apu->square2Output || triangleOutput != apu->triangleOutput || noiseOutput != apu->noiseOutput || DMCOutput != apu->DMCOutput) {
+		apu->square1Output = square1Output;
+		apu->square2Output = square2Output;
+		apu->triangleOutput = triangleOutput;
+		apu->noiseOutput = noiseOutput;
+		apu->DMCOutput = DMCOutput;
+
+		int32_t output = mixChannels(apu, square1Output, square2Output, triangleOutput, noiseOutput, DMCOutput);
+		if (apu->blip != NULL)
+			addDeltaBlip(apu->blip, apu->clock - apu->frameStart, output - apu->mixedOutput);
+		apu->mixedOutput = output;
+	}
+	apu->clock++;
+}
+
+// Catches up to the given clock, producing the same output as running every cycle with tickAPU
+// Between register accesses, the APU's state only changes on a few cycles (see cyclesToNextEvent), and those before them are skipped all at once
+void runAPU(APU *apu, uint64_t cycle) {
+	while (apu->clock < cycle) {
+		const uint64_t next = (apu->outputStale && !SHADOW(apu)) ? 1 : cyclesToNextEvent(apu);
+		if (next > cycle - apu->clock) {
+			skipCycles(apu, cycle - apu->clock);
+			break;
+		}
+		skipCycles(apu, next - 1);
+		if (SHADOW(apu)) {
+			clockFrameCounter(apu);
+			apu->clock++;
+		} else {
+			tickAPU(apu);
+		}
+	}
+	predictFrameIRQ(apu);
+}
+
+// Output goes to blip as deltas timestamped in CPU cycles, until endFrameAPU is called
+void setBlipAPU(APU *apu, Blip *blip) {
+	apu->blip = blip;
+	apu->frameStart = apu->clock;
+}
+
+// Without blip, the APU is only a shadow: it only runs its frame counter, which is all the CPU can observe
+// Once a log is set, it also logs every write to its registers, for the APU synthesizing the output on the audio thread (see apulog.h)
+void setLogAPU(APU *apu, APULog *log) {
+	apu->log = log;
+}
+
+// Catches up to the given clock and makes every sample output so far available in blip (or logs the end of the frame)
+void endFrameAPU(APU *apu, uint64_t cycle) {
+	runAPU(apu, cycle);
+	if (apu->log != NULL)
+		logFrameEndAPU(apu->log, apu->clock);
+	else if (apu->blip != NULL)
+		endFrameBlip(apu->blip, apu->clock - apu->frameStart);
+	apu->frameStart = apu->clock;
 }
 
 #undef FRAMECOUNTER_5STEP
@@ -339,4 +536,5 @@ void tickAPU(APU *apu) {
 #undef DMCENABLED
 #undef SQUARE1PERIOD
 #undef SQUARE2PERIOD
-#undef TRIANGLEPERIOD
\ No newline at end of file
+#undef TRIANGLEPERIOD
+#undef SHADOW
\ No newline at end of file
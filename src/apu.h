@@ -4,6 +4,8 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+#include "blip.h"
+
 #define APU_LENGTHCOUNTER_MASK 0b11111000
 
 #define APU_SQUARE1_ENVELOPE_MISC 0x00
@@ -27,6 +29,9 @@
 #define APU_CTRL 0x15
 #define APU_FRAMECOUNTER 0x17
 
+// Forward declaration so there is no circular dependency (see apulog.h)
+typedef struct APULog APULog;
+
 // TODO open bus, particularly the internal CPU open bus behavious when reading 0x4015
 
 typedef struct APU {
@@ -72,7 +77,22 @@ typedef struct APU {
 	double squareMixerLookup[31];
 	double tndMixerLookup[203];
 
-	float currentSample;
+	// Last output of each channel: the mixed output only changes (and a delta is only added to blip) when one of them does
+	uint8_t square1Output;
+	uint8_t square2Output;
+	uint8_t triangleOutput;
+	uint8_t noiseOutput;
+	uint8_t DMCOutput;
+	int32_t mixedOutput; // In units of 1 / BLIP_AMPLITUDE
+
+	Blip *blip; // Where the output goes; without it, the APU is only a shadow (see setLogAPU)
+	APULog *log; // Where register writes go, if anywhere
+
+	// The APU doesn't need to run every cycle, only when something depends on it (see runAPU), so it keeps its own time in CPU cycles
+	uint64_t clock; // Cycles run since initAPU
+	uint64_t frameStart; // Clock at which the current audio frame started
+	uint64_t irqClock; // Clock from which irqOutFrame will be set if nothing is written before, UINT64_MAX if it won't
+	bool outputStale; // A register was written since the last cycle run, so the output must be computed again on the next one
 } APU;
 
 // Interface functions
@@ -80,9 +100,13 @@ void initAPU(APU *apu);
 uint8_t readRegisterAPU(APU *apu, uint16_t address);
 void writeRegisterAPU(APU *apu, uint16_t address, uint8_t data);
 void tickAPU(APU *apu);
+void runAPU(APU *apu, uint64_t cycle);
+void setBlipAPU(APU *apu, Blip *blip);
+void setLogAPU(APU *apu, APULog *log);
+void endFrameAPU(APU *apu, uint64_t cycle);
 
 // Non-interface functions
-float mixChannels(APU *apu, uint8_t square1In, uint8_t square2In, uint8_t triangleIn, uint8_t noiseIn, uint8_t DMCIn);
+int32_t mixChannels(APU *apu, uint8_t square1In, uint8_t square2In, uint8_t triangleIn, uint8_t noiseIn, uint8_t DMCIn);
 void clockLengthCounters(APU *apu);
 void clockSweepUnits(APU *apu);
 void clockLinearCounter(APU *apu);
@@ -90,5 +114,12 @@ void clockEnvelopes(APU *apu);
 void clockEnvelope(uint8_t envelopeRegister, bool *restartEnvelope, uint8_t *volumeCounter, uint8_t *envelopeDivider);
 uint16_t targetSweepPeriod(uint8_t sweepRegister, uint16_t currentPeriod, bool isSquare2);
 uint8_t envelopeVolume(uint8_t envelopeRegister, uint8_t envelopeCounter);
+void clockFrameCounter(APU *apu);
+void clockNoiseShiftRegister(APU *apu);
+uint64_t advanceTimer(uint16_t *timer, uint16_t reload, uint64_t cycles);
+uint64_t advanceSquareTimer(uint16_t *timer, uint16_t reload, uint64_t divider, uint64_t cycles);
+uint64_t cyclesToNextEvent(const APU *apu);
+void skipCycles(APU *apu, uint64_t cycles);
+void predictFrameIRQ(APU *apu);
 
 #endif // ifndef APU_H
\ No newline at end of file
@@ -0,0 +1,97 @@
+#include "apulog.h"
+
+#include <stdio.h>
+
+
+// Non-interface functions
+void replayEntry(APULog *log, const APULogEntry *entry) {
+	if (entry->address == APULOG_FRAMEEND) {
+		endFrameAPU(&log->apu, entry->cycle);
+		log->frameSamples(log->userData, &log->blip);
+	} else {
+		runAPU(&log->apu, entry->cycle);
+		writeRegisterAPU(&log->apu, entry->address, entry->value);
+	}
+}
+
+// Replays everything logged, then sleeps until more is
+void *replayLog(void *arg) {
+	APULog *log = (APULog *)arg;
+
+	while (true) {
+		const uint32_t read = log->readIndex;
+		const uint32_t available = ringAvailable(&log->writeIndex, read);
+		if (available == 0) {
+			if (!waitForPush(&log->waiter))
+				break;
+			continue;
+		}
+
+		for (uint32_t i = 0; i < available; i++)
+			replayEntry(log, &log->entries[(read + i) & APULOG_MASK]);
+		publishRing(&log->readIndex, read + available);
+		signalPopped(&log->waiter);
+	}
+
+	return NULL;
+}
+
+void pushEntry(APULog *log, uint64_t cycle, uint16_t address, uint8_t value) {
+	const uint32_t write = log->writeIndex;
+	if (ringFill(write, &log->readIndex) == APULOG_SIZE) {
+		// Writes can't be dropped without the output going wrong for good, so the emulation thread has to wait
+		log->stalls++;
+		waitForRoom(&log->waiter, write, &log->readIndex, APULOG_SIZE);
+	}
+
+	APULogEntry *entry = &log->entries[write & APULOG_MASK];
+	entry->cycle = cycle;
+	entry->address = address;
+	entry->value = value;
+	publishRing(&log->writeIndex, write + 1);
+}
+
+
+// Interface functions
+// The audio thread's APU and blip start from scratch, so this must be called before anything is written to the shadow APU
+int initAPULog(APULog *log, double clockRate, double sampleRate, FrameSamplesFunction frameSamples, void *userData) {
+	log->writeIndex = log->readIndex = 0;
+	log->writes = log->stalls = 0;
+
+	initAPU(&log->apu);
+	initBlip(&log->blip, clockRate, sampleRate);
+	setBlipAPU(&log->apu, &log->blip);
+	log->frameSamples = frameSamples;
+	log->userData = userData;
+
+	initRingWaiter(&log->waiter);
+	if (pthread_create(&log->thread, NULL, replayLog, log) != 0) {
+		printf("Error : couldn't create audio thread.\n");
+		destroyRingWaiter(&log->waiter);
+		return -0x01;
+	}
+
+	return 0;
+}
+
+// Everything logged is replayed before the audio thread stops
+void terminateAPULog(APULog *log) {
+	closeRing(&log->waiter);
+	pthread_join(log->thread, NULL);
+	destroyRingWaiter(&log->waiter);
+}
+
+void logWriteAPU(APULog *log, uint64_t cycle, uint16_t address, uint8_t value) {
+	pushEntry(log, cycle, address, value);
+	log->writes++;
+}
+
+// The audio thread is only woken up once a frame, to replay the whole frame at once
+void logFrameEndAPU(APULog *log, uint64_t cycle) {
+	pushEntry(log, cycle, APULOG_FRAMEEND, 0);
+	signalPushed(&log->waiter);
+}
+
+void printAPULog(const APULog *log) {
+	printf("APU log : %llu register writes replayed on the audio thread, emulation waited %llu times for it\n", (unsigned long long)log->writes, (unsigned long long)log->stalls);
+}
\ No newline at end of file
@@ -0,0 +1,54 @@
+#ifndef APULOG_H
+#define APULOG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "apu.h"
+#include "blip.h"
+#include "ring.h"
+
+// Writes to the APU's registers go from the emulation thread to the audio thread through a ring (see ring.h)
+#define APULOG_SIZE 16384 // Must be a power of two
+#define APULOG_MASK (APULOG_SIZE - 1)
+#define APULOG_FRAMEEND 0xFFFF // Address of the entries marking the end of a frame
+
+typedef struct APULogEntry {
+	uint64_t cycle; // Clock of the APU when it was written
+	uint16_t address;
+	uint8_t value;
+} APULogEntry;
+
+// Called on the audio thread at the end of every frame, with the samples of that frame waiting in blip
+typedef void (*FrameSamplesFunction)(void *userData, Blip *blip);
+
+// The emulation thread only runs a shadow of the APU (see setLogAPU), enough to answer the CPU, and logs every write to its registers
+// The audio thread replays them at the same cycles through its own APU, so the output is exactly what the APU would have output on the emulation thread
+typedef struct APULog {
+	APULogEntry entries[APULOG_SIZE];
+
+	_Alignas(CACHE_LINE) uint32_t writeIndex; // Written by the emulation thread
+	uint64_t writes; // Only touched by the emulation thread
+	uint64_t stalls; // Times the emulation thread had to wait for the audio thread because the ring was full
+	_Alignas(CACHE_LINE) uint32_t readIndex; // Written by the audio thread
+
+	// Only touched by the audio thread
+	APU apu;
+	Blip blip;
+	FrameSamplesFunction frameSamples;
+	void *userData;
+
+	// The audio thread sleeps until the end of a frame is logged, or the ring is full
+	pthread_t thread;
+	RingWaiter waiter;
+} APULog;
+
+// Interface functions
+int initAPULog(APULog *log, double clockRate, double sampleRate, FrameSamplesFunction frameSamples, void *userData);
+void terminateAPULog(APULog *log);
+void logWriteAPU(APULog *log, uint64_t cycle, uint16_t address, uint8_t value);
+void logFrameEndAPU(APULog *log, uint64_t cycle);
+void printAPULog(const APULog *log);
+
+#endif // ifndef APULOG_H
\ No newline at end of file
@@ -1,103 +1,122 @@
 #include "audio.h"
 
-#include <stdio.h>
+#include <string.h>
+
+#include "capture.h"
+
+const AudioSink *audioSinks[] = {
+#ifndef NESREV_NOAUDIO
+	&portaudioSink,
+#endif
+	&nullSink,
+	&wavSink,
+	&rawSink
+};
 
 
 // Non-interface functions
-float mod(uint64_t dividend, float divisor) {
-	int integerQuotient = dividend / divisor;
-	return dividend - integerQuotient * divisor;
+// The null sink throws everything away, so samples aren't even resampled for it (see writeSamples)
+int openNull(AudioEngine *engine, const char *path) {
+	return 0;
 }
 
-void terminatePortaudio(AudioEngine *engine, const char *file, int line) {
-	if (line > 0) {
-		printf("Portaudio error from file %s:%i.\n", file, line);
-	}
-	engine->portaudioIsUp = false;
-	PaError error = Pa_Terminate();
-	if (error != paNoError) {
-		printf("Portaudio error while terminating: %s\n", Pa_GetErrorText(error));
-	}
-}
+void closeNull(AudioEngine *engine) {}
 
-int portaudioCallback(const void *input, void *output, unsigned long framesPerBuffer, const PaStreamCallbackTimeInfo *timeInfo, PaStreamCallbackFlags status, void *userData) {
-	AudioData *data = (AudioData *)userData;
-	float *out = (float *)output;
-	*out = data->buffer[data->nextInBuffer];
-	if (data->nextEmpty != data->nextInBuffer) {
-		data->nextInBuffer++;
-	}
-	return 0;
+void startNull(AudioEngine *engine) {}
+
+void stopNull(AudioEngine *engine) {}
+
+int32_t writeNull(AudioEngine *engine, const float *samples, uint32_t count) {
+	return -1;
 }
 
-// Interface functions
-void initAudioEngine(AudioEngine *engine) {
-	engine->portaudioIsUp = false;
-	engine->stream = NULL;
-
-	engine->currentSampleCount = 0;
-	engine->sampleSum = 0.0f;
-	engine->samplesDownsampled = 0;
-	engine->totalSourceSamples = 0;
-	engine->nextResampling = 40;
-
-	for (uint32_t i = 0; i < 65536; i++) {
-		engine->data.buffer[i] = 0.0f;
-	}
-	engine->data.nextEmpty = 0;
-	engine->data.nextInBuffer = 0;
+void printNull(const AudioEngine *engine) {}
 
-	if (Pa_Initialize() != paNoError) {
-		printf("Portaudio error: couldn't initialize.\n");
-		return;
+const AudioSink nullSink = {"null", false, openNull, closeNull, startNull, stopNull, writeNull, printNull};
+
+
+// Interface functions
+// Returns the sink with the given name, NULL if there is none
+const AudioSink *findAudioSink(const char *name) {
+	for (size_t i = 0; i < sizeof(audioSinks) / sizeof(audioSinks[0]); i++) {
+		if (strcmp(audioSinks[i]->name, name) == 0)
+			return audioSinks[i];
 	}
+	return NULL;
+}
 
-	if (Pa_OpenDefaultStream(&engine->stream, 0, 1, paFloat32, TARGET_SAMPLE_RATE, 1, portaudioCallback, &engine->data) != paNoError) {
-		terminatePortaudio(engine, __FILE__, __LINE__);
+// Opens the given sink, with path as its file if it is a file sink
+// If it can't be opened, the engine falls back to the null sink and returns an error
+int initAudioEngine(AudioEngine *engine, const AudioSink *sink, const char *path) {
+	engine->samplesOutput = 0;
+	engine->averageFill = 0;
+	engine->rateAdjustment = 0;
+	initResampler(&engine->resampler, SYNTHESIS_RATE, TARGET_SAMPLE_RATE);
+	engine->capture = NULL;
+
+	engine->sink = sink;
+	if (sink->open(engine, path) != 0) {
+		engine->sink = &nullSink;
+		return -0x01;
 	}
-	engine->portaudioIsUp = true;
+	return 0;
 }
 
 void terminateAudioEngine(AudioEngine *engine) {
-	if (Pa_CloseStream(engine->stream) != paNoError) {
-		terminatePortaudio(engine, __FILE__, __LINE__);
-		return;
-	}
-	engine->portaudioIsUp = false;
-	terminatePortaudio(engine, NULL, 0);
+	engine->sink->close(engine);
+	engine->sink = &nullSink;
 }
 
 void startStream(AudioEngine *engine) {
-	if (Pa_StartStream(engine->stream) != paNoError) {
-		terminatePortaudio(engine, __FILE__, __LINE__);
-	}
+	engine->sink->start(engine);
 }
 
 void stopStream(AudioEngine *engine) {
-	if (Pa_StopStream(engine->stream) != paNoError) {
-		terminatePortaudio(engine, __FILE__, __LINE__);
-	}
+	engine->sink->stop(engine);
+}
+
+void setCaptureAudio(AudioEngine *engine, Capture *capture) {
+	engine->capture = capture;
 }
 
-void newSamplef(AudioEngine *engine, float sample) {
-	engine->sampleSum += sample;
-	engine->currentSampleCount++;
-	engine->totalSourceSamples++;
-
-	if (engine->currentSampleCount >= engine->nextResampling) {
-		engine->data.buffer[engine->data.nextEmpty] = engine->sampleSum / engine->currentSampleCount;
-		engine->samplesDownsampled++;
-
-		// TODO remove this magic number
-		// Source sample rate = 1786830Hz
-		// Target sample rate = 44100Hz
-		// Downsampling factor: 1789830Hz / 44100Hz == 40.517687...
-		// So every 0.517687... target sample, we want to resample using 41 source samples instead of 40.
-		// This is equivalent to every 1 / 0.517687... == 1.931668857... target sample, use 41 source samples instead of 40.
-		engine->nextResampling = (mod(engine->samplesDownsampled, 1.931668857f) >= 1 ? 40 : 41);
-
-		engine->data.nextEmpty++;
-		engine->currentSampleCount = 0;
-		engine->sampleSum = 0.0f;
+// Moves the samples of the last frame from blip to the sink (and the capture, if any)
+void queueSamples(AudioEngine *engine, Blip *blip) {
+	const uint32_t count = readSamplesBlip(blip, engine->block, BLIP_SIZE);
+	if (engine->capture != NULL)
+		captureAudio(engine->capture, engine->block, count);
+	writeSamples(engine, engine->block, count);
+}
+
+// Resamples count synthesized samples to the sink, and adjusts the ratio of the resampler for the next ones if the sink plays them in real time
+void writeSamples(AudioEngine *engine, const float *samples, uint32_t count) {
+	if (!engine->sink->output)
+		return;
+	Resampler *resampler = &engine->resampler;
+	writeResampler(resampler, samples, count);
+
+	int32_t fill = -1;
+	uint32_t output;
+	while ((output = readResampler(resampler, engine->output, AUDIO_OUTPUT_BLOCK)) > 0) {
+		const int32_t waiting = engine->sink->write(engine, engine->output, output);
+		if (fill < 0)
+			fill = waiting;
+		engine->samplesOutput += output;
 	}
+	if (fill < 0)
+		return;
+
+	// A proportional controller on the (smoothed) fill level of the buffer: more samples than the target means audio is produced faster than it is played, so each output sample takes a bit more synthesized samples
+	engine->averageFill += (fill - engine->averageFill) * FILL_SMOOTHING;
+	engine->rateAdjustment = (engine->averageFill - TARGET_BUFFER_FILL) / TARGET_BUFFER_FILL * MAX_RATE_ADJUSTMENT;
+	if (engine->rateAdjustment > MAX_RATE_ADJUSTMENT)
+		engine->rateAdjustment = MAX_RATE_ADJUSTMENT;
+	else if (engine->rateAdjustment < -MAX_RATE_ADJUSTMENT)
+		engine->rateAdjustment = -MAX_RATE_ADJUSTMENT;
+	adjustRateResampler(resampler, engine->rateAdjustment);
+}
+
+// To be called once the stream is stopped
+void printAudioEngine(const AudioEngine *engine) {
+	printf("Audio (%s) : %llu samples output, final rate adjustment of %+.3f%%\n", engine->sink->name, (unsigned long long)engine->samplesOutput, engine->rateAdjustment * 100);
+	engine->sink->print(engine);
 }
\ No newline at end of file
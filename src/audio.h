@@ -1,44 +1,99 @@
 #ifndef AUDIO_H
 #define AUDIO_H
 
+#include <stdio.h>
 #include <stdint.h>
 #include <stdbool.h>
 
-#include "Portaudio/portaudio.h"
+#include "blip.h"
+#include "resample.h"
+#include "ring.h"
 
 #define TARGET_SAMPLE_RATE 44100
+#define SOURCE_CLOCK_RATE 1789773.0 // The APU output is timestamped in CPU cycles
+#define SYNTHESIS_RATE (SOURCE_CLOCK_RATE / 32) // Blip synthesizes at a fixed rate above every usual output rate, which the resampler brings to TARGET_SAMPLE_RATE
 
-typedef struct AudioData {
-	uint16_t nextInBuffer;
-	uint16_t nextEmpty;
-	float buffer[65536];
-} AudioData;
-
-typedef struct AudioEngine {
-	PaStream *stream;
-	AudioData data;
-	bool portaudioIsUp;
-	float sampleSum;
-	int currentSampleCount;
-	uint64_t samplesDownsampled;
-	uint64_t totalSourceSamples;
-	int nextResampling;
-} AudioEngine;
+// The ratio of the resampler is adjusted so the buffer of a real-time sink holds about TARGET_BUFFER_FILL samples (46 ms), by at most MAX_RATE_ADJUSTMENT so the change in pitch can't be heard
+#define TARGET_BUFFER_FILL 2048
+#define MAX_RATE_ADJUSTMENT 0.005
+#define FILL_SMOOTHING (1.0 / 8) // Weight of each new measure of the fill level (once a frame) in its moving average
+
+// Samples go from the emulation thread to the audio callback through a ring (see ring.h), which never waits on either side: samples that don't fit are dropped, and missing ones are made up
+#define AUDIO_RING_SIZE 16384 // Must be a power of two
+#define AUDIO_RING_MASK (AUDIO_RING_SIZE - 1)
+#define AUDIO_BLOCK_FRAMES 512 // Samples requested from the callback at once (11.6 ms)
+#define AUDIO_OUTPUT_BLOCK 1024 // Resampled samples handed to the sink at once (more than a frame at 48 kHz)
+
+typedef struct AudioRing {
+	float buffer[AUDIO_RING_SIZE];
+
+	_Alignas(CACHE_LINE) uint32_t writeIndex; // Written by the emulation thread
+	uint64_t overruns; // Samples dropped because the ring was full, only touched by the emulation thread
+
+	_Alignas(CACHE_LINE) uint32_t readIndex; // Written by the callback
+	uint64_t underruns; // Samples the callback had to make up because the ring was empty, only touched by the callback
+	float lastSample; // Repeated on underruns, which clicks less than silence
+} AudioRing;
+
+typedef struct AudioEngine AudioEngine;
+// Forward declaration so there is no circular dependency (see capture.h)
+typedef struct Capture Capture;
+
+// Where samples end up, selected at runtime (see findAudioSink)
+// Every function gets the whole engine, whose sink-specific fields are only touched by the sink it was opened with
+typedef struct AudioSink {
+	const char *name;
+	bool output; // False if samples are thrown away, in which case there is no need to synthesize them at all
+	int (*open)(AudioEngine *engine, const char *path); // path is only used by file sinks
+	void (*close)(AudioEngine *engine);
+	void (*start)(AudioEngine *engine);
+	void (*stop)(AudioEngine *engine);
+	// Takes count samples, and returns how many were still waiting to be played before them, or -1 if the sink isn't played in real time (and needs no rate control)
+	int32_t (*write)(AudioEngine *engine, const float *samples, uint32_t count);
+	void (*print)(const AudioEngine *engine);
+} AudioSink;
+
+struct AudioEngine {
+	const AudioSink *sink;
+	uint64_t samplesOutput;
+
+	// Emulation doesn't run at exactly the NES frame rate (it follows a timer or the display), and the audio device doesn't play at exactly its sample rate either
+	// The difference is absorbed by the resampling ratio, adjusted according to the number of samples in the buffer of a real-time sink
+	double averageFill;
+	double rateAdjustment; // Relative change to the number of synthesized samples per output sample, between -MAX_RATE_ADJUSTMENT and MAX_RATE_ADJUSTMENT
+	Resampler resampler;
+	float block[BLIP_SIZE]; // Samples of a frame, between blip and the resampler
+	float output[AUDIO_OUTPUT_BLOCK]; // Resampled samples, on their way to the sink
+	Capture *capture; // Also gets every sample synthesized, if set
+
+	// PortAudio sink
+	void *stream;
+	AudioRing ring;
+
+	// File sinks
+	FILE *file;
+	bool pipe; // The file is the input of a command (see openOutput)
+	bool wav; // The file starts with a WAV header, whose sizes are filled in when the file is closed (unless it can't be rewound)
+	uint64_t bytesWritten;
+};
+
+// Sinks
+extern const AudioSink nullSink;
+extern const AudioSink portaudioSink; // Not available when compiling without audio engine (NESREV_NOAUDIO)
+extern const AudioSink wavSink;
+extern const AudioSink rawSink;
 
 // Interface functions
-void initAudioEngine(AudioEngine *engine);
+const AudioSink *findAudioSink(const char *name);
+int initAudioEngine(AudioEngine *engine, const AudioSink *sink, const char *path);
 void terminateAudioEngine(AudioEngine *engine);
 void startStream(AudioEngine *engine);
 void stopStream(AudioEngine *engine);
-void newSamplef(AudioEngine *engine, float sample);
-
-#ifdef NESREV_NOAUDIO
-// If compiling without audio engine, define methods as empty
-void initAudioEngine(AudioEngine *engine) {}
-void terminateAudioEngine(AudioEngine *engine) {}
-void startStream(AudioEngine *engine) {}
-void stopStream(AudioEngine *engine) {}
-void newSamplef(AudioEngine *engine, float sample) {}
-#endif //ifdef NESREV_NOAUDIO
+void setCaptureAudio(AudioEngine *engine, Capture *capture);
+void queueSamples(AudioEngine *engine, Blip *blip);
+void writeSamples(AudioEngine *engine, const float *samples, uint32_t count);
+void printAudioEngine(const AudioEngine *engine);
+FILE *openOutput(const char *path, bool *pipe);
+void closeOutput(FILE *file, bool pipe);
 
 #endif // ifndef AUDIO_H
\ No newline at end of file
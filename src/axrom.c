@@ -0,0 +1,45 @@
+#include "mapper.h"
+
+#include "cartridge.h"
+
+// AxROM: a 32KiB PRG bank (bits 0-2) and the single-screen nametable (bit 4) selected by writes to ROM space, and 8KiB of CHR RAM
+// AOROM boards have no bus conflicts and games made for them write arbitrary values, so they aren't emulated (games made for the other boards avoid conflicts anyway)
+#define AXROM_PRG 0b00000111
+#define AXROM_SCREEN 0b00010000
+
+typedef struct AxROMState {
+	uint8_t latch;
+} AxROMState;
+
+
+// Non-interface functions
+void syncAxROM(Cartridge *cart) {
+	const AxROMState *state = cart->mapperState;
+	mapPRG(cart, 0, 4, (state->latch & AXROM_PRG) << 15);
+	setMirroring(cart, (state->latch & AXROM_SCREEN) ? MIRROR_1SCREENB : MIRROR_1SCREENA);
+}
+
+void initAxROM(Cartridge *cart) {
+	mapCHR(cart, 0, 8, 0x0000);
+	syncAxROM(cart);
+}
+
+void writePRGAxROM(Bus *bus, uint16_t address, uint8_t data) {
+	Cartridge *cart = bus->cartridge;
+	if (address < 0x8000) {
+		writePRGRAM(cart, address, data);
+		return;
+	}
+
+	((AxROMState *)cart->mapperState)->latch = data;
+	syncAxROM(cart);
+}
+
+
+// Interface functions
+const Mapper axromMapper = {
+	MAPPER_AXROM, "AxROM", sizeof(AxROMState), false, initAxROM,
+	readPRGBanks, writePRGAxROM, readCHRBanks, writeCHRBanks,
+	NULL, NULL,
+	syncAxROM
+};
\ No newline at end of file
@@ -0,0 +1,124 @@
+#include "blip.h"
+
+#include <math.h>
+#include <string.h>
+#include <pthread.h>
+
+// Band-limited impulse for each phase: the output samples a delta is spread over, as a windowed sinc (Blackman window, cut off a bit below the output Nyquist frequency)
+// Summing the impulse sample after sample gives the band-limited step, which is done when the samples are read
+#define BLIP_CUTOFF 0.9 // Relative to the output Nyquist frequency
+// Shared by every blip and only ever read once built, which happens once per process (see initBlip)
+static int32_t stepTable[BLIP_PHASES][BLIP_TAPS];
+static pthread_once_t stepTableBuilt = PTHREAD_ONCE_INIT;
+
+
+// Non-interface functions
+void buildStepTable(void) {
+	const double pi = 3.14159265358979323846;
+	for (int phase = 0; phase < BLIP_PHASES; phase++) {
+		double impulse[BLIP_TAPS];
+		double sum = 0;
+		for (int i = 0; i < BLIP_TAPS; i++) {
+			// Distance from the center of the step, which lies BLIP_TAPS / 2 samples after where it was added
+			double x = i - (BLIP_TAPS / 2 - 1) - (double)phase / BLIP_PHASES;
+			double window = 0.42 + 0.5 * cos(pi * x / (BLIP_TAPS / 2)) + 0.08 * cos(2 * pi * x / (BLIP_TAPS / 2));
+			double sinc = (x == 0) ? 1 : sin(pi * BLIP_CUTOFF * x) / (pi * BLIP_CUTOFF * x);
+			impulse[i] = window * sinc;
+			sum += impulse[i];
+		}
+
+		// Rounding errors go to the largest tap, so every step sums to exactly 1 and the output doesn't drift
+		int32_t total = 0;
+		int largest = 0;
+		for (int i = 0; i < BLIP_TAPS; i++) {
+			stepTable[phase][i] = (int32_t)floor(impulse[i] / sum * (1 << BLIP_KERNELBITS) + 0.5);
+			total += stepTable[phase][i];
+			if (stepTable[phase][i] > stepTable[phase][largest])
+				largest = i;
+		}
+		stepTable[phase][largest] += (1 << BLIP_KERNELBITS) - total;
+	}
+}
+
+
+// Interface functions
+void initBlip(Blip *blip, double clockRate, double sampleRate) {
+	pthread_once(&stepTableBuilt, buildStepTable);
+
+	setRatesBlip(blip, clockRate, sampleRate);
+	clearBlip(blip);
+}
+
+// Can be changed between frames, to follow a drifting clock or sample rate
+void setRatesBlip(Blip *blip, double clockRate, double sampleRate) {
+	blip->clockRate = clockRate;
+	blip->sampleRate = sampleRate;
+	blip->factor = (uint64_t)(sampleRate / clockRate * ((uint64_t)1 << BLIP_TIMEBITS) + 0.5);
+}
+
+void clearBlip(Blip *blip) {
+	blip->offset = 0;
+	blip->available = 0;
+	blip->integrator = 0;
+	memset(blip->buffer, 0, sizeof(blip->buffer));
+}
+
+// Adds a change of the output, clock cycles after the start of the current frame
+void addDeltaBlip(Blip *blip, uint32_t clock, int32_t delta) {
+	const uint64_t position = blip->offset + clock * blip->factor;
+	const uint64_t index = position >> BLIP_TIMEBITS;
+	const int32_t *step = stepTable[(position >> (BLIP_TIMEBITS - BLIP_PHASEBITS)) & (BLIP_PHASES - 1)];
+
+	// Samples must be read every few frames; past BLIP_SIZE, changes are lost
+	if (index >= BLIP_SIZE)
+		return;
+
+	int64_t *out = &blip->buffer[index];
+	for (int i = 0; i < BLIP_TAPS; i++)
+		out[i] += (int64_t)delta * step[i];
+}
+
+// Ends the current frame after the given number of clocks, making every sample before its end available
+// Deltas of the next frame are relative to its end
+void endFrameBlip(Blip *blip, uint32_t clocks) {
+	blip->offset += clocks * blip->factor;
+	if ((blip->offset >> BLIP_TIMEBITS) > BLIP_SIZE)
+		blip->offset = (uint64_t)BLIP_SIZE << BLIP_TIMEBITS;
+	blip->available = blip->offset >> BLIP_TIMEBITS;
+}
+
+uint32_t samplesAvailableBlip(const Blip *blip) {
+	return blip->available;
+}
+
+// Reads (and removes) up to count samples, between -1.0f and 1.0f, and returns how many were read
+// With out set to NULL, samples are removed without being read
+uint32_t readSamplesBlip(Blip *blip, float *out, uint32_t count) {
+	if (count > blip->available)
+		count = blip->available;
+
+	int64_t integrator = blip->integrator;
+	for (uint32_t i = 0; i < count; i++) {
+		integrator += blip->buffer[i];
+		int64_t sample = integrator >> BLIP_KERNELBITS;
+		// High-pass filter, removing the DC offset of the output
+		integrator -= sample * (1 << (BLIP_KERNELBITS - BLIP_HIGHPASS));
+
+		if (sample > BLIP_AMPLITUDE)
+			sample = BLIP_AMPLITUDE;
+		else if (sample < -BLIP_AMPLITUDE)
+			sample = -BLIP_AMPLITUDE;
+		if (out != NULL)
+			out[i] = (float)sample / BLIP_AMPLITUDE;
+	}
+	blip->integrator = integrator;
+
+	// Samples still waiting (and the steps of the last ones, spilling over the next frame) are moved to the start of the buffer
+	const uint32_t remaining = blip->available - count + BLIP_TAPS;
+	memmove(blip->buffer, &blip->buffer[count], remaining * sizeof(int64_t));
+	memset(&blip->buffer[remaining], 0, count * sizeof(int64_t));
+	blip->available -= count;
+	blip->offset -= (uint64_t)count << BLIP_TIMEBITS;
+
+	return count;
+}
\ No newline at end of file
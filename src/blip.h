@@ -0,0 +1,39 @@
+#ifndef BLIP_H
+#define BLIP_H
+
+#include <stdint.h>
+
+// Band-limited synthesis, in the style of blip_buf: instead of a sample every clock, the source adds a delta whenever its output changes, and each delta is spread over the output samples around it as a band-limited step
+// Output samples are the running sum of everything added to them, so a constant output costs nothing, and nothing above the output Nyquist frequency is left to alias
+#define BLIP_PHASES 64 // Positions between two output samples a step can start at (the step table has one row for each)
+#define BLIP_TAPS 16 // Output samples a step is spread over, which delays the output by BLIP_TAPS / 2 samples
+#define BLIP_SIZE 4096 // Output samples that can be waiting to be read (more than 4 frames at 56 kHz)
+
+// Fixed point formats
+#define BLIP_TIMEBITS 32 // Fractional bits of positions in output samples
+#define BLIP_PHASEBITS 6 // log2(BLIP_PHASES)
+#define BLIP_KERNELBITS 15 // Each row of the step table sums to exactly 1 << BLIP_KERNELBITS, so steps always settle on their exact amplitude
+#define BLIP_AMPLITUDE 32767 // Amplitude of the output samples read as 1.0f
+#define BLIP_HIGHPASS 9 // The output loses 1 / 2^BLIP_HIGHPASS of its amplitude every sample, removing DC (about 17 Hz at SYNTHESIS_RATE, which sound is synthesized at whatever the rate of the sink, see audio.h)
+
+typedef struct Blip {
+	double clockRate;
+	double sampleRate;
+	uint64_t factor; // Output samples per clock, with BLIP_TIMEBITS fractional bits
+	uint64_t offset; // Position of the start of the current frame from the first sample not read yet, with BLIP_TIMEBITS fractional bits
+
+	uint32_t available; // Samples before the current frame, that won't change anymore and can be read
+	int64_t integrator; // Running sum of every delta up to the first sample not read yet, with BLIP_KERNELBITS fractional bits
+	int64_t buffer[BLIP_SIZE + BLIP_TAPS]; // Deltas spread over each sample not read yet
+} Blip;
+
+// Interface functions
+void initBlip(Blip *blip, double clockRate, double sampleRate);
+void setRatesBlip(Blip *blip, double clockRate, double sampleRate);
+void clearBlip(Blip *blip);
+void addDeltaBlip(Blip *blip, uint32_t clock, int32_t delta);
+void endFrameBlip(Blip *blip, uint32_t clocks);
+uint32_t samplesAvailableBlip(const Blip *blip);
+uint32_t readSamplesBlip(Blip *blip, float *out, uint32_t count);
+
+#endif // ifndef BLIP_H
\ No newline at end of file
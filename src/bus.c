@@ -23,7 +23,11 @@ uint8_t cpuRead(Bus *bus, uint16_t address) {
 	} else if (address < 0x4020) {
 		switch (address) {
 			case OAMDMA: result = 0x00; break;
-			case APU_CTRL: result = readRegisterAPU(bus->apu, address); break;
+			case APU_CTRL:
+				// The APU only runs when it has to, so it first catches up with the CPU
+				runAPU(bus->apu, bus->cpu->cycleCount);
+				result = readRegisterAPU(bus->apu, address);
+				break;
 			case JOY1:
 			case JOY2:
 				result = readController(&bus->ports[address - JOY1]);
@@ -38,7 +42,7 @@ uint8_t cpuRead(Bus *bus, uint16_t address) {
 		}
 	} else {
 		// Mapped to cartridge
-		result = cartridgeReadPRG(bus, address);
+		result = bus->cartridge->mapper->readPRG(bus, address);
 	}
 
 	bus->cpu->rw = READ;
@@ -63,13 +67,16 @@ void cpuWrite(Bus *bus, uint16_t address, uint8_t data) {
 				}
 				bus->cpu->OAMDMApage = data;
 				break;
-			case JOY1:
-			case JOY2: writeController(&bus->ports[0], data); writeController(&bus->ports[1], data); break;
-			default: writeRegisterAPU(bus->apu, address, data); break;
+			case JOY1: writeController(&bus->ports[0], data); writeController(&bus->ports[1], data); break;
+			default:
+				// Including 0x4017, which is only the second controller when read, and the frame counter when written
+				runAPU(bus->apu, bus->cpu->cycleCount);
+				writeRegisterAPU(bus->apu, address, data);
+				break;
 		}
 	} else {
 		// Mapped to cartridge
-		cartridgeWritePRG(bus, address, data);
+		bus->cartridge->mapper->writePRG(bus, address, data);
 	}
 
 	bus->cpu->rw = WRITE;
@@ -85,8 +92,12 @@ uint8_t ppuRead(Bus *bus, uint16_t address) {
 		return bus->ppu->palettes[address & 0x1F];
 	}
 
+	// Nametables are mapped by the cartridge too, but only move when the mirroring changes (see setMirroring)
+	if (address >= 0x2000)
+		return bus->cartridge->nametables[(address >> 10) & 0b11][address & 0x3FF];
+
 	// Else, mapped to cartridge space
-	return cartridgeReadCHR(bus, address);
+	return bus->cartridge->mapper->readCHR(bus, address);
 }
 
 void ppuWrite(Bus *bus, uint16_t address, uint8_t data) {
@@ -95,8 +106,15 @@ void ppuWrite(Bus *bus, uint16_t address, uint8_t data) {
 			bus->ppu->palettes[address & 0x0F] = data;
 		}
 		bus->ppu->palettes[address & 0x1F] = data;
+	} else if (address >= 0x2000) {
+		bus->cartridge->nametables[(address >> 10) & 0b11][address & 0x3FF] = data;
 	} else {
 		// Else, mapped to cartridge space
-		cartridgeWriteCHR(bus, address, data);
+		bus->cartridge->mapper->writeCHR(bus, address, data);
 	}
+}
+
+uint16_t ppuReadTileRow(Bus *bus, uint16_t address, bool flipped) {
+	// Pattern tables are always mapped to cartridge space
+	return cartridgeReadTileRow(bus, address, flipped);
 }
\ No newline at end of file
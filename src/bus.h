@@ -22,5 +22,6 @@ uint8_t cpuRead(Bus *bus, uint16_t address);
 void cpuWrite(Bus *bus, uint16_t address, uint8_t data);
 uint8_t ppuRead(Bus *bus, uint16_t address);
 void ppuWrite(Bus *bus, uint16_t address, uint8_t data);
+uint16_t ppuReadTileRow(Bus *bus, uint16_t address, bool flipped);
 
 #endif // ifndef BUS_H
\ No newline at end of file
@@ -0,0 +1,208 @@
+#include "capture.h"
+
+#include <stdlib.h>
+
+// Undefined later
+#define CLAMP(value) ((value) < 0 ? 0 : (value) > 255 ? 255 : (value))
+
+
+// Non-interface functions
+// Converts every color of the palette to limited range BT.601 YUV, which is what Y4M is assumed to be in
+void convertPaletteYUV(uint8_t *palette) {
+	for (int i = 0; i < PALETTE_EMPHASIS_LEVELS * PALETTE_COLORS; i++) {
+		uint8_t *color = &palette[i * COLOR_COMPONENTS];
+		const double r = color[0], g = color[1], b = color[2];
+		const double y = 16 + (65.481 * r + 128.553 * g + 24.966 * b) / 255;
+		const double u = 128 + (-37.797 * r - 74.203 * g + 112.0 * b) / 255;
+		const double v = 128 + (112.0 * r - 93.786 * g - 18.214 * b) / 255;
+		color[0] = CLAMP((int)(y + 0.5));
+		color[1] = CLAMP((int)(u + 0.5));
+		color[2] = CLAMP((int)(v + 0.5));
+	}
+}
+
+void writeFrame(Capture *capture, const CaptureFrame *frame) {
+	const int size = FRAME_WIDTH * FRAME_HEIGHT;
+	// A repeated frame is written again as it was converted the last time
+	if (!frame->repeat) {
+		for (int i = 0; i < size; i++) {
+			const uint8_t *color = &capture->palette[frame->pixels[i] * COLOR_COMPONENTS];
+			if (capture->format == CAPTURE_Y4M) {
+				// One plane after the other
+				capture->output[i] = color[0];
+				capture->output[size + i] = color[1];
+				capture->output[2 * size + i] = color[2];
+			} else {
+				capture->output[i * COLOR_COMPONENTS] = color[0];
+				capture->output[i * COLOR_COMPONENTS + 1] = color[1];
+				capture->output[i * COLOR_COMPONENTS + 2] = color[2];
+			}
+		}
+	} else {
+		capture->framesRepeated++;
+	}
+
+	if (capture->format == CAPTURE_Y4M)
+		fputs("FRAME\n", capture->video);
+	fwrite(capture->output, 1, sizeof(capture->output), capture->video);
+	capture->framesWritten++;
+}
+
+// Writes everything pushed to the rings, then sleeps until more is
+void *writeCapture(void *arg) {
+	Capture *capture = (Capture *)arg;
+
+	while (true) {
+		const uint32_t frameRead = capture->frameRead, blockRead = capture->blockRead;
+		const uint32_t frames = ringAvailable(&capture->frameWrite, frameRead);
+		const uint32_t blocks = ringAvailable(&capture->blockWrite, blockRead);
+		if (frames == 0 && blocks == 0) {
+			if (!waitForPush(&capture->waiter))
+				break;
+			continue;
+		}
+
+		for (uint32_t i = 0; i < frames; i++)
+			writeFrame(capture, &capture->frames[(frameRead + i) & (CAPTURE_FRAMES - 1)]);
+		for (uint32_t i = 0; i < blocks; i++) {
+			const CaptureBlock *block = &capture->blocks[(blockRead + i) & (CAPTURE_BLOCKS - 1)];
+			writeSamples(capture->audio, block->samples, block->count);
+		}
+		publishRing(&capture->frameRead, frameRead + frames);
+		publishRing(&capture->blockRead, blockRead + blocks);
+		signalPopped(&capture->waiter);
+	}
+
+	return NULL;
+}
+
+// Waits until the writer thread made room in a ring, reporting it the first time
+void waitForWriter(Capture *capture, const uint32_t *read, uint32_t write, uint32_t size, uint64_t *stalls, const char *ring) {
+	if (*stalls == 0)
+		printf("Capture : the %s ring is full, waiting for the writer thread.\n", ring);
+	(*stalls)++;
+	waitForRoom(&capture->waiter, write, read, size);
+}
+
+
+// Interface functions
+// Frames go to videoPath and sound to audioPath (as WAV), either of which can be NULL to only capture the other, and can be a command to pipe them to (see openOutput)
+// colors and count are the palette, as given to expandPalette
+int initCapture(Capture *capture, const char *videoPath, CaptureFormat format, const char *audioPath, const uint8_t *colors, int count, bool deduplicate) {
+	capture->frameWrite = capture->frameRead = 0;
+	capture->blockWrite = capture->blockRead = 0;
+	capture->frameStalls = capture->blockStalls = 0;
+	capture->framesWritten = capture->framesRepeated = 0;
+	capture->deduplicate = deduplicate;
+	capture->lastHash = 0;
+	capture->format = format;
+	expandPalette(colors, count, capture->palette);
+	if (format == CAPTURE_Y4M)
+		convertPaletteYUV(capture->palette);
+
+	capture->video = NULL;
+	if (videoPath != NULL) {
+		capture->video = openOutput(videoPath, &capture->videoPipe);
+		if (capture->video == NULL) {
+			printf("Error : couldn't open / create video capture file %s.\n", videoPath);
+			return -0x01;
+		}
+		if (format == CAPTURE_Y4M)
+			fprintf(capture->video, "YUV4MPEG2 W%i H%i F%i:%i Ip A8:7 C444 XCOLORRANGE=LIMITED\n", FRAME_WIDTH, FRAME_HEIGHT, CAPTURE_RATE_NUMERATOR, CAPTURE_RATE_DENOMINATOR);
+	}
+
+	capture->audio = NULL;
+	if (audioPath != NULL) {
+		capture->audio = malloc(sizeof(AudioEngine));
+		if (capture->audio == NULL || initAudioEngine(capture->audio, &wavSink, audioPath) != 0) {
+			printf("Error : couldn't capture sound to %s.\n", audioPath);
+			free(capture->audio);
+			if (capture->video != NULL)
+				closeOutput(capture->video, capture->videoPipe);
+			return -0x02;
+		}
+	}
+
+	initRingWaiter(&capture->waiter);
+	if (pthread_create(&capture->thread, NULL, writeCapture, capture) != 0) {
+		printf("Error : couldn't create capture thread.\n");
+		destroyRingWaiter(&capture->waiter);
+		if (capture->audio != NULL) {
+			terminateAudioEngine(capture->audio);
+			free(capture->audio);
+		}
+		if (capture->video != NULL)
+			closeOutput(capture->video, capture->videoPipe);
+		return -0x03;
+	}
+
+	return 0;
+}
+
+// Everything pushed is written before the writer thread stops, so the producers must be done by then
+void terminateCapture(Capture *capture) {
+	closeRing(&capture->waiter);
+	pthread_join(capture->thread, NULL);
+	destroyRingWaiter(&capture->waiter);
+	if (capture->audio != NULL) {
+		terminateAudioEngine(capture->audio);
+		free(capture->audio);
+		capture->audio = NULL;
+	}
+	if (capture->video != NULL)
+		closeOutput(capture->video, capture->videoPipe);
+}
+
+// Called by the emulation thread with every frame it completes (with its line hashes computed)
+void captureFrame(Capture *capture, const Frame *frame) {
+	if (capture->video == NULL)
+		return;
+
+	const uint32_t write = capture->frameWrite;
+	if (ringFill(write, &capture->frameRead) == CAPTURE_FRAMES)
+		waitForWriter(capture, &capture->frameRead, write, CAPTURE_FRAMES, &capture->frameStalls, "frame");
+
+	CaptureFrame *slot = &capture->frames[write & (CAPTURE_FRAMES - 1)];
+	uint64_t hash = 0;
+	for (int i = 0; i < FRAME_HEIGHT; i++)
+		hash = (hash ^ frame->lineHashes[i]) * 0x100000001B3;
+	slot->repeat = capture->deduplicate && write != 0 && hash == capture->lastHash;
+	if (!slot->repeat) {
+		for (int i = 0; i < FRAME_WIDTH * FRAME_HEIGHT; i++)
+			slot->pixels[i] = frame->pixels[i];
+	}
+	capture->lastHash = hash;
+
+	publishRing(&capture->frameWrite, write + 1);
+	signalPushed(&capture->waiter);
+}
+
+// Called by the thread synthesizing sound with every sample it synthesized
+void captureAudio(Capture *capture, const float *samples, uint32_t count) {
+	if (capture->audio == NULL)
+		return;
+
+	while (count > 0) {
+		const uint32_t write = capture->blockWrite;
+		if (ringFill(write, &capture->blockRead) == CAPTURE_BLOCKS)
+			waitForWriter(capture, &capture->blockRead, write, CAPTURE_BLOCKS, &capture->blockStalls, "sound");
+
+		CaptureBlock *block = &capture->blocks[write & (CAPTURE_BLOCKS - 1)];
+		block->count = count < CAPTURE_BLOCK_SAMPLES ? count : CAPTURE_BLOCK_SAMPLES;
+		for (uint32_t i = 0; i < block->count; i++)
+			block->samples[i] = samples[i];
+		samples += block->count;
+		count -= block->count;
+
+		publishRing(&capture->blockWrite, write + 1);
+	}
+	signalPushed(&capture->waiter);
+}
+
+// To be called once the capture is terminated
+void printCapture(const Capture *capture) {
+	printf("Capture : %llu frames written (%llu repeated), ", (unsigned long long)capture->framesWritten, (unsigned long long)capture->framesRepeated);
+	printf("emulation waited %llu times for the writer thread, sound %llu times\n", (unsigned long long)capture->frameStalls, (unsigned long long)capture->blockStalls);
+}
+
+#undef CLAMP
\ No newline at end of file
@@ -0,0 +1,72 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "frames.h"
+#include "audio.h"
+#include "ring.h"
+
+// Frames and sound are handed from the threads producing them to a writer thread through two rings of preallocated slots (see ring.h)
+#define CAPTURE_FRAMES 32 // Frames a ring holds (more than half a second), must be a power of two
+#define CAPTURE_BLOCKS 64 // Blocks of samples a ring holds (about a frame each), must be a power of two
+#define CAPTURE_BLOCK_SAMPLES 1024
+
+// Exact NES frame rate (the PPU clock divided by 89341.5 dots a frame), as a fraction for the Y4M header
+#define CAPTURE_RATE_NUMERATOR 39375000
+#define CAPTURE_RATE_DENOMINATOR 655171
+
+typedef enum CaptureFormat {
+	CAPTURE_Y4M, // YUV4MPEG2, 4:4:4 (so pixels keep their colors), with the frame rate and pixel aspect ratio in the header
+	CAPTURE_RGB // Raw frames of 8-bit RGB, without any header
+} CaptureFormat;
+
+typedef struct CaptureFrame {
+	uint16_t pixels[FRAME_WIDTH * FRAME_HEIGHT]; // Palette indices (see PIXEL in ppu.h)
+	bool repeat; // Same as the previous frame, whose pixels weren't even copied
+} CaptureFrame;
+
+typedef struct CaptureBlock {
+	float samples[CAPTURE_BLOCK_SAMPLES]; // As synthesized, at SYNTHESIS_RATE
+	uint32_t count;
+} CaptureBlock;
+
+// Emulation never waits for the writer thread, unless a ring is full, which is counted and reported
+typedef struct Capture {
+	CaptureFrame frames[CAPTURE_FRAMES];
+	CaptureBlock blocks[CAPTURE_BLOCKS];
+
+	_Alignas(CACHE_LINE) uint32_t frameWrite; // Written by the emulation thread
+	bool deduplicate; // Frames with the same hash as the previous one are only marked as repeated
+	uint64_t lastHash;
+	uint64_t frameStalls; // Times the emulation thread had to wait for the writer thread because the ring was full
+	_Alignas(CACHE_LINE) uint32_t blockWrite; // Written by the thread synthesizing sound
+	uint64_t blockStalls;
+	_Alignas(CACHE_LINE) uint32_t frameRead; // Both written by the writer thread
+	uint32_t blockRead;
+
+	// Only touched by the writer thread
+	FILE *video; // NULL if only sound is captured, set once by initCapture
+	bool videoPipe;
+	CaptureFormat format;
+	uint8_t palette[PALETTE_EMPHASIS_LEVELS * PALETTE_COLORS * COLOR_COMPONENTS]; // Converted to YUV for Y4M
+	uint8_t output[FRAME_WIDTH * FRAME_HEIGHT * COLOR_COMPONENTS]; // Last frame written, ready to be written again
+	uint64_t framesWritten, framesRepeated;
+	AudioEngine *audio; // Resamples the sound to a WAV sink, NULL if only frames are captured
+
+	// The writer thread sleeps until something is pushed to either ring
+	pthread_t thread;
+	RingWaiter waiter;
+} Capture;
+
+// Interface functions
+int initCapture(Capture *capture, const char *videoPath, CaptureFormat format, const char *audioPath, const uint8_t *colors, int count, bool deduplicate);
+void terminateCapture(Capture *capture);
+void captureFrame(Capture *capture, const Frame *frame);
+void captureAudio(Capture *capture, const float *samples, uint32_t count);
+void printCapture(const Capture *capture);
+
+#endif // ifndef CAPTURE_H
\ No newline at end of file
@@ -1,193 +1,102 @@
 #include "cartridge.h"
 #include "bus.h"
-#include "cpu.h"
-
-#define MIRROR_HORZ_ADDR(address) ((address & 0x3FF) | ((address >> 1) & 0x400))
-#define MIRROR_VERT_ADDR(address) (address & 0x7FF)
-#define MIRROR_1SCA_ADDR(address) (address & 0x3FF)
-#define MIRROR_1SCB_ADDR(address) ((address & 0x3FF) | 0x400)
-
-uint8_t cartridgeReadPRG(Bus *bus, uint16_t address) {
-	switch (bus->cartridge->mapperID) {
-		case MAPPER_NROM:
-			// TODO the mirroring (... & (cart->PRGsize - 1)) isn't right AT ALL (cartridge space starts at 0x6000)
-			if (address < 0x8000) {
-				// TODO I have no idea how to deal with this
-				return 0x00;
-			} else {
-				return bus->cartridge->PRG[(address & 0x7FFF) & (bus->cartridge->PRGsize - 1)];
-			}
-
-			break;
-		
-		case MAPPER_MMC1:
-			if (address < 0x8000) {
-				// TODO the same as NROM.
-				if (address >= 0x6000 && bus->cartridge->persistentRAM) {
-					return bus->cartridge->persistentRAM[address - 0x6000];
-				}
-				return 0x00;
-			} else if (!(bus->cartridge->registers[MMC1_REG_CTRL] & MMC1_CTRL_PRG16K_ENABLE)) {
-				// 32K mode
-				return bus->cartridge->PRG[((address & 0x7FFF) | ((bus->cartridge->registers[MMC1_REG_PRG] & 0b1110) << 14)) & (bus->cartridge->PRGsize - 1)];
-			} else if (!(bus->cartridge->registers[MMC1_REG_CTRL] & MMC1_CTRL_PRG16K_SELECT)) {
-				// First 16K is fixed, second is switchable
-				if (address < 0xC000) {
-					return bus->cartridge->PRG[(address & 0x3FFF)];
-				} else {
-					return bus->cartridge->PRG[((address & 0x3FFF) | (bus->cartridge->registers[MMC1_REG_PRG] << 14)) & (bus->cartridge->PRGsize - 1)];
-				}
-			} else {
-				// First 16K is switchable, second is fixed
-				if (address < 0xC000) {
-					//if (bus->cartridge->registers[MMC1_REG_PRG] == 0x00) printf("%04X -> %04X\n", address, ((address & 0x3FFF) | (bus->cartridge->registers[MMC1_REG_PRG] << 14)) & (bus->cartridge->PRGsize - 1));
-					return bus->cartridge->PRG[((address & 0x3FFF) | (bus->cartridge->registers[MMC1_REG_PRG] << 14)) & (bus->cartridge->PRGsize - 1)];
-				} else {
-					return bus->cartridge->PRG[((address & 0x3FFF) | (0x0F << 14)) & (bus->cartridge->PRGsize - 1)];
-				}
-			}
-
-
-			break;
-		
-		default:
-			return 0x00;
-			break;
-	}
 
-	// Something went wrong.
-	return 0x00;
+// 1KiB pages of VRAM mapped to each nametable for every mirroring type: 0 and 1 are the console's internal VRAM, 2 and 3 the extra VRAM of four-screen boards
+const uint8_t mirroringPages[6][4] = {
+	[MIRROR_UNKNOWN] = {0, 1, 0, 1},
+	[MIRROR_1SCREENA] = {0, 0, 0, 0},
+	[MIRROR_1SCREENB] = {1, 1, 1, 1},
+	[MIRROR_VERTICAL] = {0, 1, 0, 1},
+	[MIRROR_HORIZONTAL] = {0, 0, 1, 1},
+	[MIRROR_4SCREEN] = {0, 1, 2, 3}
+};
+
+
+// Non-interface functions
+void writePatternRAM(Cartridge *cart, uint32_t offset, uint8_t data) {
+	if (!cart->CHRisRAM)
+		return;
+	cart->CHR[offset] = data;
+	// Only the row containing the written byte needs to be decoded again
+	decodeTileRow(cart, ((offset >> 1) & ~0b111) | (offset & 0b111));
 }
 
-void cartridgeWritePRG(Bus *bus, uint16_t address, uint8_t data) {
-	switch (bus->cartridge->mapperID) {
-		case MAPPER_NROM:
-			// PRG ROM; no writes
-			break;
-
-		case MAPPER_MMC1:
-			if (address >= 0x6000 && address < 0x8000 && bus->cartridge->persistentRAM) {
-				bus->cartridge->persistentRAM[address - 0x6000] = data;
-			} else if (address >= 0x8000) {
-				// Write to cartridge register
-				// Consecutives writes are ignored
-				if (bus->cpu->cycleCount <= bus->cartridge->registers[MMC1_REG_TIMESTAMP] + 1) {
-					break;
-				}
-
-				bus->cartridge->registers[MMC1_REG_TIMESTAMP] = bus->cpu->cycleCount;
-
-				if (data & MMC1_RESET_BIT) {
-					// We set the register to 1 so we can detect when there has been 5 shifts (5 writes) to dump the shift register's data into one of the other 4 registers
-					bus->cartridge->registers[MMC1_REG_SHIFT] = MMC1_REG_SHIFT_DEFAULTVALUE;
-					bus->cartridge->registers[MMC1_REG_CTRL] |= MMC1_REG_CTRL_DEFAULTVALUE; // Only these bits are set, the others are unchanged
-				} else {
-					bus->cartridge->registers[MMC1_REG_SHIFT] >>= 1;
-					bus->cartridge->registers[MMC1_REG_SHIFT] |= (data & 0b1) << 5;
-
-					if (bus->cartridge->registers[MMC1_REG_SHIFT] & 0b1) {
-						// The initial set bit (in bit 4 of default value) is now bit 0, writing sequence completed
-						bus->cartridge->registers[(address >> 13) & 0b11] = bus->cartridge->registers[MMC1_REG_SHIFT] >> 1;
-						bus->cartridge->registers[MMC1_REG_SHIFT] = MMC1_REG_SHIFT_DEFAULTVALUE;
-
-						if (((address >> 13) & 0b11) == MMC1_REG_CTRL) {
-							switch (bus->cartridge->registers[MMC1_REG_CTRL] & MMC1_CTRL_MIRRORING) {
-								case 0b00: bus->cartridge->mirroringType = MIRROR_1SCREENA; break;
-								case 0b01: bus->cartridge->mirroringType = MIRROR_1SCREENB; break;
-								case 0b10: bus->cartridge->mirroringType = MIRROR_VERTICAL; break;
-								case 0b11: bus->cartridge->mirroringType = MIRROR_HORIZONTAL; break;
-							}
-						}
-					}
-				}
-			}
-
-			break;
-		
-		default:
-			break;
+
+// Interface functions
+// Maps count 8KiB slots of PRG space, starting with slot (0 for 0x8000), to consecutive banks of PRG starting at offset
+// Offsets wrap around the size of PRG, which mirrors smaller ROMs over the whole space
+void mapPRG(Cartridge *cart, int slot, int count, uint32_t offset) {
+	for (int i = 0; i < count; i++)
+		cart->PRGbanks[slot + i] = &cart->PRG[(offset + i * 0x2000) & (cart->PRGsize - 1)];
+}
+
+// Same with 1KiB slots of the pattern tables, for both the CHR bytes and their pre-decoded rows
+void mapCHR(Cartridge *cart, int slot, int count, uint32_t offset) {
+	for (int i = 0; i < count; i++) {
+		const uint32_t bank = (offset + i * 0x400) & (cart->CHRsize - 1);
+		cart->CHRbanks[slot + i] = &cart->CHR[bank];
+		// Every CHR byte pair (one in each plane) is a row, and each row is stored twice (normal and mirrored), so CHR offsets translate directly to cache offsets
+		cart->CHRtileBanks[slot + i] = &cart->CHRtileCache[bank];
 	}
 }
 
-uint8_t cartridgeReadCHR(Bus *bus, uint16_t address) {
-	switch (bus->cartridge->mapperID) {
-		case MAPPER_NROM:
-			// TODO NROM-128 vs NROM-256
-			if (address >= 0x2000) {
-				if (bus->cartridge->mirroringType == MIRROR_HORIZONTAL) {
-					return bus->cartridge->internalVRAM[MIRROR_HORZ_ADDR(address)];
-				} else if (bus->cartridge->mirroringType == MIRROR_VERTICAL) {
-					return bus->cartridge->internalVRAM[MIRROR_VERT_ADDR(address)];
-				}
-			} // TODO 4 screen
-			return bus->cartridge->CHR[address & 0x1FFF];
-
-		case MAPPER_MMC1:
-			if (address >= 0x2000) {
-				// Nametable
-				// We rely on the register and not on bus->cartridge->mirroringType because I'm the developer and I get to make the rules
-				switch (bus->cartridge->registers[MMC1_REG_CTRL] & MMC1_CTRL_MIRRORING) {
-					case 0b00:
-						return bus->cartridge->internalVRAM[MIRROR_1SCA_ADDR(address)];
-					case 0b01:
-						return bus->cartridge->internalVRAM[MIRROR_1SCB_ADDR(address)];
-					case 0b10:
-						return bus->cartridge->internalVRAM[MIRROR_VERT_ADDR(address)];
-					case 0b11:
-						return bus->cartridge->internalVRAM[MIRROR_HORZ_ADDR(address)];
-				}
-			} else {
-				// Pattern table
-				if (bus->cartridge->registers[MMC1_REG_CTRL] & MMC1_CTRL_CHR4K_ENABLE) {
-					// 4K mode
-					if (address < 0x1000) {
-						return bus->cartridge->CHR[(address & 0x0FFF) | (bus->cartridge->registers[MMC1_REG_CHR1] << 12)];
-					}
-					return bus->cartridge->CHR[(address & 0x0FFF) | (bus->cartridge->registers[MMC1_REG_CHR2] << 12)];
-				}
-				// 8K mode
-				return bus->cartridge->CHR[(address & 0x1FFF) | ((bus->cartridge->registers[MMC1_REG_CHR1] & 0b11110) << 12)];
-			}
-			break;
+// Also to be called by mappers whenever they change the mirroring
+// Four-screen mirroring needs the extra VRAM, which is only allocated if the header asks for it
+void setMirroring(Cartridge *cart, uint8_t type) {
+	cart->mirroringType = type;
+	for (int i = 0; i < 4; i++) {
+		const uint8_t page = mirroringPages[type][i];
+		cart->nametables[i] = (page < 2) ? &cart->internalVRAM[page * 0x400] : &cart->extraVRAM[(page - 2) * 0x400];
 	}
+}
 
-	// Something went wrong
+uint8_t readPRGBanks(Bus *bus, uint16_t address) {
+	if (address >= 0x8000)
+		return bus->cartridge->PRGbanks[(address >> 13) & 0b11][address & 0x1FFF];
+	// TODO open bus, and cartridge space actually starts at 0x4020
+	if (address >= 0x6000 && bus->cartridge->persistentRAM)
+		return bus->cartridge->persistentRAM[address - 0x6000];
 	return 0x00;
 }
 
-void cartridgeWriteCHR(Bus *bus, uint16_t address, uint8_t data) {
-	if (address < 0x2000) {
-		if (bus->cartridge->CHRisRAM) {
-			bus->cartridge->CHR[address] = data;
-		}
-		return;
-	}
+// For mappers with no registers below 0x8000
+void writePRGRAM(Cartridge *cart, uint16_t address, uint8_t data) {
+	if (address >= 0x6000 && address < 0x8000 && cart->persistentRAM)
+		cart->persistentRAM[address - 0x6000] = data;
+}
+
+// Boards latching writes to ROM space without disabling the ROM see both the written value and the ROM byte on the data bus, which is their AND
+uint8_t busConflict(const Cartridge *cart, uint16_t address, uint8_t data) {
+	return data & cart->PRGbanks[(address >> 13) & 0b11][address & 0x1FFF];
+}
+
+uint8_t readCHRBanks(Bus *bus, uint16_t address) {
+	return bus->cartridge->CHRbanks[address >> 10][address & 0x3FF];
+}
 
-	switch (bus->cartridge->mapperID) {
-		case MAPPER_NROM:
-			if (bus->cartridge->mirroringType == MIRROR_HORIZONTAL) {
-				bus->cartridge->internalVRAM[MIRROR_HORZ_ADDR(address)] = data;
-			} else if (bus->cartridge->mirroringType == MIRROR_VERTICAL) {
-				bus->cartridge->internalVRAM[MIRROR_VERT_ADDR(address)] = data;
-			} // TODO 4 screen
-			break;
-		
-		case MAPPER_MMC1:
-			switch (bus->cartridge->registers[MMC1_REG_CTRL] & MMC1_CTRL_MIRRORING) {
-				case 0b00:
-					bus->cartridge->internalVRAM[MIRROR_1SCA_ADDR(address)] = data;
-					break;
-				case 0b01:
-					bus->cartridge->internalVRAM[MIRROR_1SCB_ADDR(address)] = data;
-					break;
-				case 0b10:
-					bus->cartridge->internalVRAM[MIRROR_VERT_ADDR(address)] = data;
-					break;
-				case 0b11:
-					bus->cartridge->internalVRAM[MIRROR_HORZ_ADDR(address)] = data;
-					break;
-			}
-
-			break;
+void writeCHRBanks(Bus *bus, uint16_t address, uint8_t data) {
+	Cartridge *cart = bus->cartridge;
+	writePatternRAM(cart, (cart->CHRbanks[address >> 10] - cart->CHR) + (address & 0x3FF), data);
+}
+
+uint16_t cartridgeReadTileRow(Bus *bus, uint16_t address, bool flipped) {
+	// Within a 1KiB slot, a row is selected by the tile number (bits 4-9) and the fine y offset (bits 0-2), and bit 3 (low or high plane) is irrelevant
+	return bus->cartridge->CHRtileBanks[(address >> 10) & 0b111][((((address & 0x03F0) >> 1) | (address & 0b111)) << 1) | flipped];
+}
+
+void decodeTileRow(Cartridge *cart, uint32_t row) {
+	// Each tile is 16 bytes: 8 bytes of low plane followed by 8 bytes of high plane
+	const uint8_t low = cart->CHR[((row & ~0b111) << 1) | (row & 0b111)];
+	const uint8_t high = cart->CHR[((row & ~0b111) << 1) | 0b1000 | (row & 0b111)];
+
+	uint16_t pixels = 0, flippedPixels = 0;
+	for (int i = 0; i < 8; i++) {
+		// Bit i of each plane is pixel (7 - i), counting from the left
+		const uint16_t pixel = ((low >> i) & 0b1) | (((high >> i) & 0b1) << 1);
+		pixels |= pixel << (i << 1);
+		flippedPixels |= pixel << ((7 - i) << 1);
 	}
+
+	cart->CHRtileCache[row << 1] = pixels;
+	cart->CHRtileCache[(row << 1) | 1] = flippedPixels;
 }
\ No newline at end of file
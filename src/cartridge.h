@@ -5,6 +5,7 @@
 #include <stdbool.h>
 
 #include "bus.h"
+#include "mapper.h"
 
 #define MIRROR_UNKNOWN 0
 #define MIRROR_1SCREENA 1
@@ -13,44 +14,46 @@
 #define MIRROR_HORIZONTAL 4 // Vertical arrangement, so horizontal mirroring
 #define MIRROR_4SCREEN 5
 
-#define MAPPER_NROM 0
-#define MAPPER_MMC1 1
-
-#define MMC1_REG_CTRL 0
-#define MMC1_REG_CHR1 1
-#define MMC1_REG_CHR2 2
-#define MMC1_REG_PRG 3
-#define MMC1_REG_SHIFT 4
-#define MMC1_REG_TIMESTAMP 5
-#define MMC1_CTRL_MIRRORING 0b00011
-#define MMC1_CTRL_PRG16K_SELECT 0b00100
-#define MMC1_CTRL_PRG16K_ENABLE 0b01000
-#define MMC1_CTRL_CHR4K_ENABLE 0b10000
-#define MMC1_RESET_BIT 0b10000000
-#define MMC1_REG_CTRL_DEFAULTVALUE 0b01100
-#define MMC1_REG_SHIFT_DEFAULTVALUE 0b100000
-
 typedef struct Cartridge {
 	uint16_t mapperID;
+	const Mapper *mapper;
+	void *mapperState; // Private to the mapper, NULL if it has none
+	bool irqOut; // IRQ output of the mapper
 	uint8_t mirroringType;
 
 	uint8_t internalVRAM[0x0800];
+	uint8_t *extraVRAM; // 2KiB more on four-screen boards, NULL otherwise
+	// Each 1KiB nametable (from 0x2000, mirrored from 0x3000) points into internalVRAM or extraVRAM, as arranged by the mirroring (see setMirroring)
+	uint8_t *nametables[4];
 
-	uint8_t *PRG;
-	uint8_t *CHR;
+	const uint8_t *PRG;
+	uint8_t *CHR; // Only writable when it is RAM
+	void *image; // Private to the loader (see ines.c): the mapped file PRG and CHR ROM point into, NULL if the cartridge wasn't loaded from one
 	uint32_t PRGsize;
 	uint32_t CHRsize;
 
 	uint8_t *persistentRAM;
 	bool CHRisRAM;
 
-	uint8_t *registers;
-	int registerCount; // TODO think about if we need this
+	// Pre-decoded CHR: every pattern row is expanded to 8 two-bit pixels (leftmost pixel in the most significant bits), immediately followed by its horizontally mirrored copy
+	uint16_t *CHRtileCache;
+	// What is currently mapped to each 8KiB slot of PRG space (from 0x8000) and each 1KiB slot of the pattern tables, set by the mapper whenever its banks change (see mapPRG and mapCHR) so accesses don't have to work it out
+	const uint8_t *PRGbanks[4];
+	uint8_t *CHRbanks[8];
+	uint16_t *CHRtileBanks[8]; // Pre-decoded rows of the same slots
 } Cartridge;
 
-uint8_t cartridgeReadPRG(Bus *bus, uint16_t address);
-void cartridgeWritePRG(Bus *bus, uint16_t address, uint8_t data);
-uint8_t cartridgeReadCHR(Bus *bus, uint16_t address);
-void cartridgeWriteCHR(Bus *bus, uint16_t address, uint8_t data);
+// Shared by the mappers
+void mapPRG(Cartridge *cart, int slot, int count, uint32_t offset);
+void mapCHR(Cartridge *cart, int slot, int count, uint32_t offset);
+uint8_t readPRGBanks(Bus *bus, uint16_t address);
+void writePRGRAM(Cartridge *cart, uint16_t address, uint8_t data);
+uint8_t busConflict(const Cartridge *cart, uint16_t address, uint8_t data);
+uint8_t readCHRBanks(Bus *bus, uint16_t address);
+void writeCHRBanks(Bus *bus, uint16_t address, uint8_t data);
+void setMirroring(Cartridge *cart, uint8_t type);
+uint16_t cartridgeReadTileRow(Bus *bus, uint16_t address, bool flipped);
+
+void decodeTileRow(Cartridge *cart, uint32_t row);
 
 #endif // ifndef CARTRIDGE_H
\ No newline at end of file
@@ -0,0 +1,41 @@
+#include "mapper.h"
+
+#include "cartridge.h"
+
+// CNROM: PRG as on NROM, and an 8KiB CHR bank selected by writes to ROM space
+
+typedef struct CNROMState {
+	uint8_t bank;
+} CNROMState;
+
+
+// Non-interface functions
+void syncCNROM(Cartridge *cart) {
+	const CNROMState *state = cart->mapperState;
+	mapCHR(cart, 0, 8, state->bank << 13);
+}
+
+void initCNROM(Cartridge *cart) {
+	mapPRG(cart, 0, 4, 0x0000);
+	syncCNROM(cart);
+}
+
+void writePRGCNROM(Bus *bus, uint16_t address, uint8_t data) {
+	Cartridge *cart = bus->cartridge;
+	if (address < 0x8000) {
+		writePRGRAM(cart, address, data);
+		return;
+	}
+
+	((CNROMState *)cart->mapperState)->bank = busConflict(cart, address, data);
+	syncCNROM(cart);
+}
+
+
+// Interface functions
+const Mapper cnromMapper = {
+	MAPPER_CNROM, "CNROM", sizeof(CNROMState), false, initCNROM,
+	readPRGBanks, writePRGCNROM, readCHRBanks, writeCHRBanks,
+	NULL, NULL,
+	syncCNROM
+};
\ No newline at end of file
@@ -0,0 +1,43 @@
+#include "mapper.h"
+
+#include "cartridge.h"
+
+// Color Dreams: a 32KiB PRG bank (bits 0-1) and an 8KiB CHR bank (bits 4-7) selected by writes to ROM space
+#define COLORDREAMS_PRG 0b00000011
+#define COLORDREAMS_CHR 0b11110000
+
+typedef struct ColorDreamsState {
+	uint8_t latch;
+} ColorDreamsState;
+
+
+// Non-interface functions
+void syncColorDreams(Cartridge *cart) {
+	const ColorDreamsState *state = cart->mapperState;
+	mapPRG(cart, 0, 4, (state->latch & COLORDREAMS_PRG) << 15);
+	mapCHR(cart, 0, 8, ((state->latch & COLORDREAMS_CHR) >> 4) << 13);
+}
+
+void initColorDreams(Cartridge *cart) {
+	syncColorDreams(cart);
+}
+
+void writePRGColorDreams(Bus *bus, uint16_t address, uint8_t data) {
+	Cartridge *cart = bus->cartridge;
+	if (address < 0x8000) {
+		writePRGRAM(cart, address, data);
+		return;
+	}
+
+	((ColorDreamsState *)cart->mapperState)->latch = busConflict(cart, address, data);
+	syncColorDreams(cart);
+}
+
+
+// Interface functions
+const Mapper colorDreamsMapper = {
+	MAPPER_COLORDREAMS, "Color Dreams", sizeof(ColorDreamsState), false, initColorDreams,
+	readPRGBanks, writePRGColorDreams, readCHRBanks, writeCHRBanks,
+	NULL, NULL,
+	syncColorDreams
+};
\ No newline at end of file
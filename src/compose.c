@@ -0,0 +1,171 @@
+#include "compose.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define COMPOSE_X86
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#endif
+
+// Undefined later
+#define GREYSCALE(mask) ((mask) & MASK_GREYSCALE ? 0x30 : 0x3F)
+
+// Non-interface functions
+static inline void writeColor(PPU *ppu, uint16_t pix, uint8_t color, uint8_t mask) {
+	ppu->framebuffer[ppu->scanline * 256 + pix] = PIXEL(color, mask);
+}
+
+#ifdef COMPOSE_X86
+// Multiplexes the 16 pending pixels (some of which may be garbage past pendingCount) into palette indices
+// Also returns the greyscale mask of each pixel in grey, as it is applied after the palette lookup
+static inline __attribute__((target("sse2"))) __m128i composeIndices(PPU *ppu, __m128i *grey) {
+	#define BITSET(vector, bit) _mm_cmpeq_epi8(_mm_and_si128((vector), _mm_set1_epi8(bit)), _mm_set1_epi8(bit))
+
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i bg = _mm_loadu_si128((const __m128i *)ppu->pendingBg);
+	const __m128i mask = _mm_loadu_si128((const __m128i *)ppu->pendingMask);
+	const __m128i spr = _mm_loadu_si128((const __m128i *)&ppu->sprLine[ppu->pendingPixel]);
+
+	// Lanes for pixels 0-7 of the scanline, where sprites and background may be hidden according to PPUMASK
+	__m128i left = zero;
+	if (ppu->pendingPixel < 8)
+		left = _mm_cmplt_epi8(_mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15), _mm_set1_epi8(8 - ppu->pendingPixel));
+
+	const __m128i sprShown = _mm_andnot_si128(_mm_andnot_si128(BITSET(mask, MASK_SHOWLEFTSPR), left), BITSET(mask, MASK_RENDERSPR));
+	const __m128i bgShown = _mm_andnot_si128(_mm_andnot_si128(BITSET(mask, MASK_SHOWLEFTBG), left), BITSET(mask, MASK_RENDERBG));
+	const __m128i sprTransparent = _mm_cmpeq_epi8(_mm_and_si128(_mm_and_si128(spr, _mm_set1_epi8(SPRLINE_COLOR)), sprShown), zero);
+	const __m128i bgTransparent = _mm_cmpeq_epi8(_mm_and_si128(_mm_and_si128(bg, _mm_set1_epi8(0b11)), bgShown), zero);
+
+	// Multiplexer: an opaque sprite pixel wins over a transparent background or when it has priority
+	const __m128i sprWins = _mm_andnot_si128(sprTransparent, _mm_or_si128(bgTransparent, _mm_cmpeq_epi8(_mm_and_si128(spr, _mm_set1_epi8(SPRLINE_PRIORITY)), zero)));
+	const __m128i sprIndex = _mm_or_si128(_mm_set1_epi8(0b10000), _mm_and_si128(spr, _mm_set1_epi8(SPRLINE_COLOR | SPRLINE_PALETTE)));
+	const __m128i bgIndex = _mm_andnot_si128(bgTransparent, _mm_and_si128(bg, _mm_set1_epi8(0b1111)));
+	__m128i paletteIndex = _mm_or_si128(_mm_and_si128(sprWins, sprIndex), _mm_andnot_si128(sprWins, bgIndex));
+
+	// Weird palette mirroring
+	paletteIndex = _mm_andnot_si128(_mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(paletteIndex, _mm_set1_epi8(0b11)), zero), _mm_set1_epi8(0b1111)), paletteIndex);
+
+	*grey = _mm_or_si128(_mm_set1_epi8(0x30), _mm_andnot_si128(BITSET(mask, MASK_GREYSCALE), _mm_set1_epi8(0x0F)));
+	return paletteIndex;
+
+	#undef BITSET
+}
+
+// Adds emphasis bits to the colors of the pending pixels and writes them to the framebuffer
+static inline __attribute__((target("sse2"))) void storePixels(PPU *ppu, __m128i colors) {
+	if (ppu->pendingCount < 16) {
+		uint8_t colorArray[16];
+		_mm_storeu_si128((__m128i *)colorArray, colors);
+		for (int i = 0; i < ppu->pendingCount; i++)
+			writeColor(ppu, ppu->pendingPixel + i, colorArray[i], ppu->pendingMask[i]);
+		return;
+	}
+
+	// PIXEL(): emphasis bits 5-6 of PPUMASK end up in bits 6-7 of the low byte, and bit 7 in bit 0 of the high byte
+	const __m128i mask = _mm_loadu_si128((const __m128i *)ppu->pendingMask);
+	const __m128i low = _mm_or_si128(colors, _mm_and_si128(_mm_add_epi8(mask, mask), _mm_set1_epi8(0b11000000)));
+	const __m128i high = _mm_and_si128(_mm_cmplt_epi8(mask, _mm_setzero_si128()), _mm_set1_epi8(0b1));
+	uint16_t *pixels = &ppu->framebuffer[ppu->scanline * 256 + ppu->pendingPixel];
+	_mm_storeu_si128((__m128i *)pixels, _mm_unpacklo_epi8(low, high));
+	_mm_storeu_si128((__m128i *)&pixels[8], _mm_unpackhi_epi8(low, high));
+}
+#endif // ifdef COMPOSE_X86
+
+
+// Interface functions
+ComposeFunction selectComposer(void) {
+#ifdef COMPOSE_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("ssse3"))
+		return composePixelsSSSE3;
+	if (__builtin_cpu_supports("sse2"))
+		return composePixelsSSE2;
+#endif
+	return composePixelsScalar;
+}
+
+void buildSpriteLine(PPU *ppu) {
+	for (int i = 0; i < SPRLINE_SIZE; i++)
+		ppu->sprLine[i] = 0;
+
+	// Lower sprite units have priority, so they are drawn last
+	for (int i = 7; i >= 0; i--) {
+		if (!ppu->sprPattern[i])
+			continue;
+
+		const uint8_t attributes = ((ppu->sprAttributes[i] & SPR_PALETTE) << 2) | (ppu->sprAttributes[i] & SPR_PRIORITY) | (i == 0 ? SPRLINE_ZERO : 0);
+		for (int j = 0; j < 8; j++) {
+			const uint8_t color = (ppu->sprPattern[i] >> ((7 - j) << 1)) & 0b11;
+			if (color)
+				ppu->sprLine[ppu->sprXPos[i] + j] = color | attributes;
+		}
+	}
+}
+
+void composePixelsScalar(PPU *ppu) {
+	for (int i = 0; i < ppu->pendingCount; i++) {
+		const uint16_t pix = ppu->pendingPixel + i;
+		const uint8_t mask = ppu->pendingMask[i];
+		const uint8_t spr = ppu->sprLine[pix];
+		uint8_t sprColor = spr & SPRLINE_COLOR;
+		uint8_t bgColor = ppu->pendingBg[i] & 0b11;
+
+		// Disables rendering according to PPUMASK
+		if (!(mask & MASK_RENDERSPR) || (!(mask & MASK_SHOWLEFTSPR) && pix < 8))
+			sprColor = 0;
+		if (!(mask & MASK_RENDERBG) || (!(mask & MASK_SHOWLEFTBG) && pix < 8))
+			bgColor = 0;
+
+		// Multiplexer
+		uint8_t paletteIndex = 0;
+		if (sprColor && (!bgColor || !(spr & SPRLINE_PRIORITY)))
+			paletteIndex = 0b10000 | (spr & (SPRLINE_COLOR | SPRLINE_PALETTE));
+		else if (bgColor)
+			paletteIndex = ppu->pendingBg[i];
+
+		// Weird palette mirroring
+		if ((paletteIndex & 0b11) == 0)
+			paletteIndex &= 0b10000;
+
+		writeColor(ppu, pix, ppu->palettes[paletteIndex] & GREYSCALE(mask), mask);
+	}
+	ppu->pendingCount = 0;
+}
+
+#ifdef COMPOSE_X86
+__attribute__((target("sse2"))) void composePixelsSSE2(PPU *ppu) {
+	uint8_t paletteIndices[16], colors[16];
+	__m128i grey;
+	_mm_storeu_si128((__m128i *)paletteIndices, composeIndices(ppu, &grey));
+
+	// SSE2 has no byte shuffle, so the palette lookup is left to scalar code
+	for (int i = 0; i < 16; i++)
+		colors[i] = ppu->palettes[paletteIndices[i]];
+
+	storePixels(ppu, _mm_and_si128(_mm_loadu_si128((const __m128i *)colors), grey));
+	ppu->pendingCount = 0;
+}
+
+__attribute__((target("ssse3"))) void composePixelsSSSE3(PPU *ppu) {
+	__m128i grey;
+	const __m128i paletteIndex = composeIndices(ppu, &grey);
+
+	// Palette lookup: each half of the palette RAM is a 16-entry shuffle table, and bit 4 of the index selects the half
+	const __m128i lowIndex = _mm_and_si128(paletteIndex, _mm_set1_epi8(0b1111));
+	const __m128i lowHalf = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)ppu->palettes), lowIndex);
+	const __m128i highHalf = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)&ppu->palettes[16]), lowIndex);
+	const __m128i isHigh = _mm_cmpeq_epi8(_mm_and_si128(paletteIndex, _mm_set1_epi8(0b10000)), _mm_set1_epi8(0b10000));
+	storePixels(ppu, _mm_and_si128(_mm_or_si128(_mm_and_si128(isHigh, highHalf), _mm_andnot_si128(isHigh, lowHalf)), grey));
+	ppu->pendingCount = 0;
+}
+#else
+// Without x86 vector extensions, both paths fall back to scalar code
+void composePixelsSSE2(PPU *ppu) {
+	composePixelsScalar(ppu);
+}
+
+void composePixelsSSSE3(PPU *ppu) {
+	composePixelsScalar(ppu);
+}
+#endif // ifdef COMPOSE_X86
+
+#undef GREYSCALE
\ No newline at end of file
@@ -0,0 +1,21 @@
+#ifndef COMPOSE_H
+#define COMPOSE_H
+
+#include <stdint.h>
+
+#include "ppu.h"
+
+// Sprite line buffer entries (output of the 8 sprite units for a single pixel)
+#define SPRLINE_COLOR 0b00000011
+#define SPRLINE_PALETTE 0b00001100
+#define SPRLINE_PRIORITY SPR_PRIORITY
+#define SPRLINE_ZERO 0b01000000
+
+// Interface functions
+ComposeFunction selectComposer(void);
+void buildSpriteLine(PPU *ppu);
+void composePixelsScalar(PPU *ppu);
+void composePixelsSSE2(PPU *ppu);
+void composePixelsSSSE3(PPU *ppu);
+
+#endif // ifndef COMPOSE_H
\ No newline at end of file
@@ -0,0 +1,127 @@
+#include "audio.h"
+
+#include <string.h>
+#include <signal.h>
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#define PIPE_MODE "wb"
+#else
+#define PIPE_MODE "w"
+#endif
+
+// Samples are written as 16-bit signed little-endian PCM, on a single channel
+#define FILESINK_BITS 16
+#define FILESINK_HEADER 44 // Size of the WAV header
+#define FILESINK_BLOCK 256 // Samples converted at once before being written
+
+
+// Non-interface functions
+void putLittleEndian(uint8_t *bytes, uint32_t value, int size) {
+	for (int i = 0; i < size; i++)
+		bytes[i] = (value >> (8 * i)) & 0xFF;
+}
+
+// Sizes are only known once the file is closed, which is when the header is written again with them
+// Until then (or for good, if the file is a pipe), they are set to the largest size possible, which is what readers of streamed WAV expect
+void writeWavHeader(FILE *file, uint32_t dataSize) {
+	uint8_t header[FILESINK_HEADER];
+	memcpy(header, "RIFF", 4);
+	putLittleEndian(&header[4], FILESINK_HEADER - 8 + dataSize, 4);
+	memcpy(&header[8], "WAVEfmt ", 8);
+	putLittleEndian(&header[16], 16, 4); // Size of the format chunk
+	putLittleEndian(&header[20], 1, 2); // PCM
+	putLittleEndian(&header[22], 1, 2); // Channels
+	putLittleEndian(&header[24], TARGET_SAMPLE_RATE, 4);
+	putLittleEndian(&header[28], TARGET_SAMPLE_RATE * FILESINK_BITS / 8, 4); // Bytes per second
+	putLittleEndian(&header[32], FILESINK_BITS / 8, 2); // Bytes per sample
+	putLittleEndian(&header[34], FILESINK_BITS, 2);
+	memcpy(&header[36], "data", 4);
+	putLittleEndian(&header[40], dataSize, 4);
+	fwrite(header, 1, FILESINK_HEADER, file);
+}
+
+int openFile(AudioEngine *engine, const char *path, bool wav) {
+	if (path == NULL) {
+		printf("Error : no file given to the %s audio sink.\n", wav ? "WAV" : "raw");
+		return -0x01;
+	}
+	engine->file = openOutput(path, &engine->pipe);
+	if (engine->file == NULL) {
+		printf("Error : couldn't open / create audio file %s.\n", path);
+		return -0x02;
+	}
+	engine->wav = wav;
+	engine->bytesWritten = 0;
+	if (wav)
+		writeWavHeader(engine->file, UINT32_MAX - FILESINK_HEADER);
+	return 0;
+}
+
+int openWav(AudioEngine *engine, const char *path) {
+	return openFile(engine, path, true);
+}
+
+int openRaw(AudioEngine *engine, const char *path) {
+	return openFile(engine, path, false);
+}
+
+void closeFile(AudioEngine *engine) {
+	// Past 4 GiB, the sizes of a WAV file are wrong, but most players still read it to the end
+	if (engine->wav && !engine->pipe && fseek(engine->file, 0, SEEK_SET) == 0)
+		writeWavHeader(engine->file, engine->bytesWritten > UINT32_MAX - FILESINK_HEADER ? UINT32_MAX - FILESINK_HEADER : (uint32_t)engine->bytesWritten);
+	closeOutput(engine->file, engine->pipe);
+	engine->file = NULL;
+}
+
+void startFile(AudioEngine *engine) {}
+
+void stopFile(AudioEngine *engine) {
+	fflush(engine->file);
+}
+
+// The file is written as fast as samples come, so there is no buffer to keep filled
+int32_t writeFile(AudioEngine *engine, const float *samples, uint32_t count) {
+	uint8_t bytes[FILESINK_BLOCK * FILESINK_BITS / 8];
+	for (uint32_t start = 0; start < count; start += FILESINK_BLOCK) {
+		const uint32_t block = (count - start < FILESINK_BLOCK) ? count - start : FILESINK_BLOCK;
+		for (uint32_t i = 0; i < block; i++) {
+			float sample = samples[start + i];
+			sample = (sample > 1.0f) ? 1.0f : (sample < -1.0f) ? -1.0f : sample;
+			putLittleEndian(&bytes[i * 2], (uint16_t)(int16_t)(sample * 32767 + (sample < 0 ? -0.5f : 0.5f)), 2);
+		}
+		engine->bytesWritten += fwrite(bytes, 1, block * 2, engine->file);
+	}
+	return -1;
+}
+
+void printFile(const AudioEngine *engine) {
+	printf("Audio file : %llu bytes of samples written\n", (unsigned long long)engine->bytesWritten);
+}
+
+const AudioSink wavSink = {"wav", true, openWav, closeFile, startFile, stopFile, writeFile, printFile};
+const AudioSink rawSink = {"raw", true, openRaw, closeFile, startFile, stopFile, writeFile, printFile};
+
+
+// Interface functions
+// Opens a file to write to, or if path starts with '|', a pipe to the standard input of the command that follows (e.g. an encoder)
+FILE *openOutput(const char *path, bool *pipe) {
+	*pipe = (path[0] == '|');
+	if (!*pipe)
+		return fopen(path, "wb");
+
+#ifndef _WIN32
+	// If the command exits early, writes fail instead of killing the emulator
+	signal(SIGPIPE, SIG_IGN);
+#endif
+	return popen(&path[1], PIPE_MODE);
+}
+
+// Waits for the command to exit if the file is a pipe
+void closeOutput(FILE *file, bool pipe) {
+	if (pipe)
+		pclose(file);
+	else
+		fclose(file);
+}
\ No newline at end of file
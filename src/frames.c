@@ -0,0 +1,100 @@
+#include "frames.h"
+
+#include <stdio.h>
+
+
+// Interface functions
+void initTripleBuffer(TripleBuffer *buffer) {
+	for (int i = 0; i < FRAME_COUNT; i++) {
+		for (int j = 0; j < FRAME_WIDTH * FRAME_HEIGHT; j++)
+			buffer->frames[i].pixels[j] = 0;
+		for (int j = 0; j < FRAME_HEIGHT; j++)
+			buffer->frames[i].lineHashes[j] = 0;
+		buffer->frames[i].completed = 0;
+	}
+	buffer->writing = 0;
+	buffer->ready = 1;
+	buffer->reading = 2;
+}
+
+// Called by the emulation thread once the frame it was writing is complete
+// Returns the frame to write next
+Frame *publishFrame(TripleBuffer *buffer) {
+	// Release makes the contents of the frame visible to the presenting thread before its index is
+	buffer->writing = __atomic_exchange_n(&buffer->ready, buffer->writing | FRAME_FRESH, __ATOMIC_ACQ_REL) & FRAME_INDEX;
+	return &buffer->frames[buffer->writing];
+}
+
+// Called by the presenting thread to get the most recent completed frame, which it can read until the next call
+// Returns NULL if no frame was completed since the last call
+const Frame *takeFrame(TripleBuffer *buffer) {
+	if (!(__atomic_load_n(&buffer->ready, __ATOMIC_RELAXED) & FRAME_FRESH))
+		return NULL;
+	buffer->reading = __atomic_exchange_n(&buffer->ready, buffer->reading, __ATOMIC_ACQ_REL) & FRAME_INDEX;
+	return &buffer->frames[buffer->reading];
+}
+
+// Finds the scanlines of a frame that differ from the frame last presented, whose hashes are then replaced with those of the new frame
+// Returns the number of scanlines that changed
+int findDirtyLines(const Frame *frame, uint64_t *presentedHashes, bool *dirtyLines) {
+	int count = 0;
+	for (int i = 0; i < FRAME_HEIGHT; i++) {
+		dirtyLines[i] = frame->lineHashes[i] != presentedHashes[i];
+		presentedHashes[i] = frame->lineHashes[i];
+		count += dirtyLines[i];
+	}
+	return count;
+}
+
+// Fills palette with the RGB components of every color for every emphasis level (the index of a pixel, see PIXEL in ppu.h), from the count colors given
+// Palettes with only PALETTE_COLORS colors get their emphasized versions computed
+void expandPalette(const uint8_t *colors, int count, uint8_t *palette) {
+	for (int i = 0; i < PALETTE_EMPHASIS_LEVELS * PALETTE_COLORS; i++) {
+		const int emphasis = i / PALETTE_COLORS;
+		for (int j = 0; j < COLOR_COMPONENTS; j++) {
+			if (count >= PALETTE_EMPHASIS_LEVELS * PALETTE_COLORS) {
+				palette[i * COLOR_COMPONENTS + j] = colors[i * COLOR_COMPONENTS + j];
+			} else {
+				// Emphasis bits are, in order, red, green and blue: every component that isn't emphasized is darkened (as long as one of them is)
+				palette[i * COLOR_COMPONENTS + j] = colors[(i % PALETTE_COLORS) * COLOR_COMPONENTS + j];
+				if (emphasis && !(emphasis & (1 << j)))
+					palette[i * COLOR_COMPONENTS + j] *= EMPHASIS_ATTENUATION;
+			}
+		}
+	}
+}
+
+void initFrameTimes(FrameTimes *times, const char *name) {
+	times->name = name;
+	for (int i = 0; i < FRAMETIMES_BUCKETS; i++)
+		times->buckets[i] = 0;
+	times->count = 0;
+	times->total = times->worst = 0;
+}
+
+void addFrameTime(FrameTimes *times, double seconds) {
+	int bucket = seconds * 1000;
+	if (bucket >= FRAMETIMES_BUCKETS)
+		bucket = FRAMETIMES_BUCKETS - 1;
+	times->buckets[bucket]++;
+	times->count++;
+	times->total += seconds;
+	if (seconds > times->worst)
+		times->worst = seconds;
+}
+
+// Prints the average and worst times, and every non-empty bucket of the histogram
+void printFrameTimes(const FrameTimes *times) {
+	if (times->count == 0)
+		return;
+
+	printf("%s : %u frames, %.2f ms on average, %.2f ms at worst\n", times->name, times->count, times->total * 1000 / times->count, times->worst * 1000);
+	for (int i = 0; i < FRAMETIMES_BUCKETS; i++) {
+		if (times->buckets[i] == 0)
+			continue;
+		if (i == FRAMETIMES_BUCKETS - 1)
+			printf("\t>= %2i ms : %7u (%5.1f%%)\n", i, times->buckets[i], 100.0 * times->buckets[i] / times->count);
+		else
+			printf("\t%2i-%2i ms : %7u (%5.1f%%)\n", i, i + 1, times->buckets[i], 100.0 * times->buckets[i] / times->count);
+	}
+}
\ No newline at end of file
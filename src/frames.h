@@ -0,0 +1,57 @@
+#ifndef FRAMES_H
+#define FRAMES_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define FRAME_WIDTH 256
+#define FRAME_HEIGHT 240
+
+#define COLOR_COMPONENTS 3 // Number of components to a color (RGB is 3, RGBA is 4)
+#define PALETTE_COLORS 64 // Number of colors the PPU can output
+#define PALETTE_EMPHASIS_LEVELS 8 // Number of combinations of the 3 emphasis bits, each with its own version of the palette
+#define EMPHASIS_ATTENUATION 0.816f // Approximation of how much the emphasis bits darken the colors they don't emphasize, for palettes without emphasis information
+
+// Frames are handed from the emulation thread to the presenting thread through a triple buffer
+#define FRAME_COUNT 3
+#define FRAME_FRESH 0b100 // Set along with the index of the ready frame until it is taken
+#define FRAME_INDEX 0b011
+
+// Frame times are counted in buckets of 1 ms, the last one taking everything longer
+#define FRAMETIMES_BUCKETS 50
+
+typedef struct Frame {
+	uint16_t pixels[FRAME_WIDTH * FRAME_HEIGHT]; // Palette indices (see PIXEL in ppu.h)
+	uint64_t lineHashes[FRAME_HEIGHT]; // See hashFramePPU
+	double completed; // Time (glfwGetTime) at which the frame was done being emulated
+} Frame;
+
+// At any time, one frame is being emulated, one is being presented and the last is the most recent completed frame
+// Neither thread ever waits on the other: the emulation thread overwrites a completed frame that wasn't taken, and the presenting thread keeps the frame it has until a new one is ready
+typedef struct TripleBuffer {
+	Frame frames[FRAME_COUNT];
+	int writing; // Only used by the emulation thread
+	int reading; // Only used by the presenting thread
+	int ready; // Exchanged atomically by both threads
+} TripleBuffer;
+
+typedef struct FrameTimes {
+	const char *name;
+	uint32_t buckets[FRAMETIMES_BUCKETS];
+	uint32_t count;
+	double total;
+	double worst;
+} FrameTimes;
+
+// Interface functions
+void initTripleBuffer(TripleBuffer *buffer);
+Frame *publishFrame(TripleBuffer *buffer);
+const Frame *takeFrame(TripleBuffer *buffer);
+int findDirtyLines(const Frame *frame, uint64_t *presentedHashes, bool *dirtyLines);
+void expandPalette(const uint8_t *colors, int count, uint8_t *palette);
+
+void initFrameTimes(FrameTimes *times, const char *name);
+void addFrameTime(FrameTimes *times, double seconds);
+void printFrameTimes(const FrameTimes *times);
+
+#endif // ifndef FRAMES_H
\ No newline at end of file
@@ -1,19 +1,16 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "graphics.h"
 
-// Triangle vertices information
-#define VERTEX_COUNT 4 // Number of vertices to drawn polygons. For rectangles (representing pixels), this is 4
-#define VERTEX_SIZE 2 // Number of components to a position (in 2D space with x and y coordinates, this is 2).
-// While OpenGL works in 3D space, VERTEX_SIZE is kept as 2 because all position vectors have a constant 1.0f as z component. We can therefore pass a 2D position to the GPU and leave it to the vertex shader to add the z component
-
-// A polygon with n sides can always be dissected in (n - 2) triangles, so the number of indices for such a dissected
-// polygon is its number of triangles multiplied by the number of vertices of a triangle, giving 3(n - 2)
-#define INDICES_PER_POLYGON (VERTEX_COUNT - 2) * 3
+// Frames are copied into a persistently mapped pixel buffer, and the frame texture is then updated from it by the GPU
+// While the GPU reads one frame of the buffer, the next is written to the other (see the fences in Context)
+#define FENCE_TIMEOUT 1000000000 // Longest wait for the GPU to be done with a frame of the pixel buffer, in nanoseconds
 
 #define TEXTURE_UNIT 0 // Texture unit used to send pixel data to the fragment shader
+#define PALETTE_UNIT 1 // Texture unit used to send the palette to the fragment shader
 
 // Non-interface functions
 
@@ -110,141 +107,152 @@ long int initShaders(const char *vertexShaderPath, const char *fragmentShaderPat
 
 // Interface functions
 
-// Sets up vertex information and sends it to bound array and element array buffers
+// Sets up the frame texture, the pixel buffer used to upload frames and the shader program
 // Returns a Context object containing all handlers information needed for drawing and terminating
 const Context setupContext(const int width, const int height) {
 	Context context;
 	context.status = false; // The success flag is only set at the end of the operation so we can safely return the context as it is if we encounter an error.
 
-	// Contrary to the index count, the vertex count is needed when calling glDraw* and is therefore stored in the context object.
+	context.width = width;
+	context.height = height;
+	context.mappedPixels = NULL;
+	context.nextBuffer = 0;
+	context.textureValid = false;
+	context.uploadedBytes = 0;
+	for (int i = 0; i < FRAME_BUFFERS; i++)
+		context.fences[i] = NULL;
+
 	// TODO deal with paths
-	context.verticesCount =  width * height * VERTEX_COUNT * VERTEX_SIZE;
 	context.idShaderProgram = initShaders("src/shaders/vertexMain.vert", "src/shaders/fragmentMain.frag");
 	if (context.idShaderProgram < 0)
 		return context;
 
 	// Generates all buffers and textures
 	glGenVertexArrays(1, &context.idVertexArray);
-	glGenBuffers(1, &context.idVertexBuffer);
-	glGenBuffers(1, &context.idElementBuffer);
-	glGenBuffers(1, &context.idTextureBuffer);
+	glGenBuffers(1, &context.idPixelBuffer);
 	glGenTextures(1, &context.idFrameTexture);
+	glGenTextures(1, &context.idPaletteTexture);
 	// At this point, the Context object should be fully initialized.
 
-	glBindVertexArray(context.idVertexArray);
-	glBindBuffer(GL_ARRAY_BUFFER, context.idVertexBuffer);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, context.idElementBuffer);
-
-	// Sets up communication with the fragment shader via a texture unit
-	// A buffer texture is used to send the pixel data to the fragment shader as a sampler
+	// Sets up communication with the fragment shader via texture units
 	// By setting the uniform to TEXTURE_UNIT, the sampler will be associated with the texture unit where the texture resides
-	glUniform1i(glGetUniformLocation(context.idShaderProgram, "texture"), TEXTURE_UNIT);
+	glUniform1i(glGetUniformLocation(context.idShaderProgram, "frame"), TEXTURE_UNIT);
+	glUniform1i(glGetUniformLocation(context.idShaderProgram, "palette"), PALETTE_UNIT);
 
-	// Indices of vertices for two triangles forming a rectangle
-	// This array is dynamically allocated to avoid memory depletion in the stack area for setupPixels
-	int indicesCount = INDICES_PER_POLYGON * height * width;
-	unsigned int *indices = malloc(sizeof(float) * indicesCount);
-	if (indices == NULL) {
-		terminateContext(context);
-		return context;
-	}
-
-	// This array is also dynamically allocated to avoid memory depletion in the stack area for setupPixels
-	float *vertices = malloc(sizeof(float) * context.verticesCount);
-	if (vertices == NULL) {
-		free(indices);
+	// Pixels are palette indices (a third of the memory of RGB), converted to RGB by the fragment shader with the palette texture
+	// Integer textures can't be filtered, so they have to be sampled with texelFetch
+	glActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT);
+	glBindTexture(GL_TEXTURE_2D, context.idFrameTexture);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_R16UI, width, height);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	// The pixel buffer stays mapped for the lifetime of the context: a frame is uploaded with a single memcpy and no driver call
+	// Coherent mapping makes the writes visible to the GPU without explicitly flushing them
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, context.idPixelBuffer);
+	glBufferStorage(GL_PIXEL_UNPACK_BUFFER, FRAME_BUFFERS * width * height * sizeof(uint16_t), NULL, flags);
+	context.mappedPixels = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, FRAME_BUFFERS * width * height * sizeof(uint16_t), flags);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	if (context.mappedPixels == NULL) {
 		terminateContext(context);
 		return context;
 	}
 
-	// Normalized width and height are 2/N instead of 1/N because normalized device coordinates range from [-1.0 ; 1.0], giving a total range of 2
-	const float pixelWidthNormalized = 2.0f / width;
-	const float pixelHeightNormalized = 2.0f / height;
-	
-	// TODO this whole thing looks like magic, but is also very ugly
-	for (int i = 0; i < height; i++) {
-		for (int j = 0; j < width; j++) {
-			int current = i * width + j;
-			for (int k = 0; k < VERTEX_COUNT; k++) {
-				// Iterates over each vertex of the rectangle
-				// TODO this assumes rectangle are drawn, which isn't bad but makes the VERTEX_COUNT expression quite worthless
-				// k = 0 : bottom-left vertex (-x, -y)
-				// k = 1 : bottom-right vertex (+x, -y)
-				// k = 2 : top-left vertex (-x, +y)
-				// k = 3 : top-right vertex (+x, +y)
-				// j + (k & 0b1) adds one to j when k mod 2 == 1. In other words, when k is for one of the right vertices, this adds 1 * pixelWidthNormalized to the x coordinate
-				// "Why are you using k & 0b1, you can check parity with the modulo operator" yeah I really don't care. 
-				vertices[(current * VERTEX_COUNT + k) * VERTEX_SIZE + 0] = pixelWidthNormalized * (j + (k & 0b1)) - 1.0f; // x coordinate
-				// i + (k > 1) adds one to i when k > 1. In other words, when k is for one of the top vertices, this adds 1 * pixelHeightNormalized to the y coordinates
-				vertices[(current * VERTEX_COUNT + k) * VERTEX_SIZE + 1] = -1 * (pixelHeightNormalized * (i + (k > 1)) - 1.0f); // y coordinate
-				// This is multiplied by -1 because, in normalized device coordinates, y == 1.0f is the top of the screen and we want the array of triangles to be top-to-bottom for the PPU
-			}
-			// For each rectangle, this fills the indices array with the correct indices to dissect it into two triangles
-			indices[current * INDICES_PER_POLYGON + 0] = current * VERTEX_COUNT + 0; // first triangle : bottom-left
-			indices[current * INDICES_PER_POLYGON + 1] = current * VERTEX_COUNT + 1; // first triangle : bottom-right
-			indices[current * INDICES_PER_POLYGON + 2] = current * VERTEX_COUNT + 2; // first triangle : top-left
-			indices[current * INDICES_PER_POLYGON + 3] = current * VERTEX_COUNT + 1; // second triangle : bottom-right
-			indices[current * INDICES_PER_POLYGON + 4] = current * VERTEX_COUNT + 2; // second triangle : top-left
-			indices[current * INDICES_PER_POLYGON + 5] = current * VERTEX_COUNT + 3; // second triangle : top-right
-		}
-	}
-
-	// Sends vertices and indices data
-	glBufferData(GL_ARRAY_BUFFER, sizeof(float) * context.verticesCount, vertices, GL_STATIC_DRAW);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(float) * indicesCount, indices, GL_STATIC_DRAW);
-	free(indices);
-	free(vertices);
-	indices = NULL;
-	vertices = NULL;
-
-	// Specifies the interpretation of vertex data
-	unsigned int idPositionLocation = glGetAttribLocation(context.idShaderProgram, "pos");
-	glVertexAttribPointer(idPositionLocation, VERTEX_SIZE, GL_FLOAT, false, VERTEX_SIZE * sizeof(float), (void *)0);
-	glEnableVertexAttribArray(idPositionLocation);
-
-	// Unbinds all bound objects
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindBuffer(GL_TEXTURE_BUFFER, 0);
-	glBindVertexArray(0);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-
 	context.status = true;
 	return context;
 }
 
-// Draws every pixel with given colors for a single frame
-// This assumes a valid shader program and vertex array object are already in use / bound and vertices / indices data is already sent to the GPU
+// Sends the RGB value of every color to the GPU
+// colors holds count 3-byte RGB colors: either PALETTE_COLORS of them, in which case emphasis is approximated, or PALETTE_COLORS * PALETTE_EMPHASIS_LEVELS with a full palette for each emphasis level
+void setPalette(const Context context, const uint8_t * const colors, const int count) {
+	uint8_t palette[PALETTE_EMPHASIS_LEVELS * PALETTE_COLORS * COLOR_COMPONENTS];
+	expandPalette(colors, count, palette);
+
+	glActiveTexture(GL_TEXTURE0 + PALETTE_UNIT);
+	glBindTexture(GL_TEXTURE_2D, context.idPaletteTexture);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, PALETTE_COLORS, PALETTE_EMPHASIS_LEVELS, 0, GL_RGB, GL_UNSIGNED_BYTE, palette);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+// Draws every pixel with given palette indices (see PIXEL in ppu.h) for a single frame
+// Only the rows set in dirtyLines (or every row if it is NULL) are copied into the next frame of the pixel buffer and uploaded into the frame texture, one sub-rectangle for each run of consecutive rows
+// The frame is then drawn as a single triangle covering the viewport
 // This does not unbind any object already bound by callee, nor does it swap buffers or poll events
-void draw(const Context context, const int width, const int height, const uint8_t * const colors) {
+// Returns the number of bytes uploaded
+size_t draw(Context * const context, const uint16_t * const pixels, const bool * const dirtyLines) {
+	const int frameSize = context->width * context->height;
+	const int buffer = context->nextBuffer;
+	context->nextBuffer = (buffer + 1) % FRAME_BUFFERS;
+
+	// The GPU could still be reading the frame uploaded FRAME_BUFFERS frames ago from this part of the buffer
+	if (context->fences[buffer] != NULL) {
+		glClientWaitSync(context->fences[buffer], GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT);
+		glDeleteSync(context->fences[buffer]);
+		context->fences[buffer] = NULL;
+	}
+
 	glClear(GL_COLOR_BUFFER_BIT);
 
-	glUseProgram(context.idShaderProgram);
-	glBindVertexArray(context.idVertexArray);
+	glUseProgram(context->idShaderProgram);
+	glBindVertexArray(context->idVertexArray);
 
-	glActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT);
-	glBindTexture(GL_TEXTURE_BUFFER, context.idFrameTexture);
+	glActiveTexture(GL_TEXTURE0 + PALETTE_UNIT);
+	glBindTexture(GL_TEXTURE_2D, context->idPaletteTexture);
 
-	// For some reason, glTexBuffer doesn't accept GL_RGB8, but it does accept GL_R8, so we send all values as colors with a single red component and seperate the red, green and blue components in the shader
-	// There are 3 alternatives :
-	// GL_RGB32F, using 4 times as much memory but removing the need for OpenGL to normalize the integers (range [0, 255]) to floats (range [0, 1]) AND the need to fetch each red, green and blue component ;
-	// GL_R16F, using twice as much memory and using weird half-floats but removing the need for OpenGL to normalize the integers to floats
-	// GL_RGBA8, using 33% more memory but removing the need to fetch each red, green and blue component.
-	// TODO Some testing may be done to find out which is best
-	glBindBuffer(GL_TEXTURE_BUFFER, context.idTextureBuffer);
-	glTexBuffer(GL_TEXTURE_BUFFER, GL_R8, context.idTextureBuffer);
-	glBufferData(GL_TEXTURE_BUFFER, width * height * COLOR_COMPONENTS * sizeof(uint8_t), colors, GL_STATIC_DRAW);
+	// With a pixel unpack buffer bound, the pointer given to glTexSubImage2D is an offset into the buffer
+	glActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT);
+	glBindTexture(GL_TEXTURE_2D, context->idFrameTexture);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, context->idPixelBuffer);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+
+	// The texture starts out undefined, so the first frame is always uploaded whole
+	const bool uploadAll = dirtyLines == NULL || !context->textureValid;
+	size_t uploaded = 0;
+	for (int first = 0; first < context->height; first++) {
+		if (!uploadAll && !dirtyLines[first])
+			continue;
+		int last = first + 1;
+		while (last < context->height && (uploadAll || dirtyLines[last]))
+			last++;
+
+		const int offset = buffer * frameSize + first * context->width;
+		const int size = (last - first) * context->width;
+		memcpy(context->mappedPixels + offset, pixels + first * context->width, size * sizeof(uint16_t));
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, first, context->width, last - first, GL_RED_INTEGER, GL_UNSIGNED_SHORT, (void *)(offset * sizeof(uint16_t)));
+		uploaded += size * sizeof(uint16_t);
+		first = last;
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	if (uploaded)
+		context->fences[buffer] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	context->textureValid = true;
+	context->uploadedBytes += uploaded;
 
-	glDrawElements(GL_TRIANGLES, context.verticesCount, GL_UNSIGNED_INT, (void *)0);
+	// No vertex data is needed: the vertex shader places the 3 vertices from their index
+	glDrawArrays(GL_TRIANGLES, 0, 3);
 
-	glBindBuffer(GL_TEXTURE_BUFFER, 0);
 	glBindVertexArray(0);
+	return uploaded;
 }
 
 void terminateContext(const Context context) {
+	for (int i = 0; i < FRAME_BUFFERS; i++) {
+		if (context.fences[i] != NULL)
+			glDeleteSync(context.fences[i]);
+	}
+	if (context.mappedPixels != NULL) {
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, context.idPixelBuffer);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
 	glDeleteVertexArrays(1, &context.idVertexArray);
-	glDeleteBuffers(1, &context.idVertexBuffer);
-	glDeleteBuffers(1, &context.idElementBuffer);
-	glDeleteBuffers(1, &context.idTextureBuffer);
+	glDeleteBuffers(1, &context.idPixelBuffer);
 	glDeleteTextures(1, &context.idFrameTexture);
+	glDeleteTextures(1, &context.idPaletteTexture);
 	glDeleteProgram(context.idShaderProgram);
 }
\ No newline at end of file
@@ -4,26 +4,34 @@
 #include "GL/glew.h"
 #include "GLFW/glfw3.h"
 
-#define COLOR_COMPONENTS 3 // Number of components to a color (RGB is 3, RGBA is 4)
+#include "frames.h"
+
+#define FRAME_BUFFERS 2 // Number of frames the pixel buffer holds, so a frame can be written while the GPU still reads the previous one
 
 typedef struct Context {
+	// Vertex array object, empty as the vertex shader generates the triangle, but needed to draw
 	unsigned int idVertexArray;
-	unsigned int idVertexBuffer;
-	unsigned int idElementBuffer;
-	// Texture, texture buffer and texture unit used to send color data to fragment shader
+	// Texture holding the palette indices of the frame, updated from the pixel buffer
 	unsigned int idFrameTexture;
-	unsigned int idTextureBuffer;
+	unsigned int idPixelBuffer;
+	uint16_t *mappedPixels; // Persistently mapped pixel buffer, FRAME_BUFFERS frames one after the other
+	GLsync fences[FRAME_BUFFERS]; // Signaled when the GPU is done uploading each frame of the pixel buffer to the texture
+	int nextBuffer; // Frame of the pixel buffer used by the next draw
+	bool textureValid; // The frame texture holds a whole frame, so only the rows that changed need to be uploaded
+	unsigned long long uploadedBytes; // Total number of bytes uploaded to the frame texture
+	int width, height;
+	// Texture holding the RGB value of every color, one row for each emphasis level
+	unsigned int idPaletteTexture;
 
 	// A long is used to keep the range of GLenum (unsigned int) while keeping negative numbers for error handling
 	long int idShaderProgram;
 
-	unsigned int verticesCount; // Total number of vertices to draw. Used to call glDrawElements.
-
 	bool status; // Used to communicate to the callee if context is ready for rendering
 } Context;
 
 const Context setupContext(const int width, const int height);
-void draw(const Context context, const int width, const int height, const uint8_t * const colors);
+void setPalette(const Context context, const uint8_t * const colors, const int count);
+size_t draw(Context * const context, const uint16_t * const pixels, const bool * const dirtyLines);
 void terminateContext(const Context context);
 
 #endif // ifndef GRAPHICS_H
\ No newline at end of file
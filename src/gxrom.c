@@ -0,0 +1,43 @@
+#include "mapper.h"
+
+#include "cartridge.h"
+
+// GxROM: a 32KiB PRG bank (bits 4-5) and an 8KiB CHR bank (bits 0-1) selected by writes to ROM space
+#define GXROM_CHR 0b00000011
+#define GXROM_PRG 0b00110000
+
+typedef struct GxROMState {
+	uint8_t latch;
+} GxROMState;
+
+
+// Non-interface functions
+void syncGxROM(Cartridge *cart) {
+	const GxROMState *state = cart->mapperState;
+	mapPRG(cart, 0, 4, ((state->latch & GXROM_PRG) >> 4) << 15);
+	mapCHR(cart, 0, 8, (state->latch & GXROM_CHR) << 13);
+}
+
+void initGxROM(Cartridge *cart) {
+	syncGxROM(cart);
+}
+
+void writePRGGxROM(Bus *bus, uint16_t address, uint8_t data) {
+	Cartridge *cart = bus->cartridge;
+	if (address < 0x8000) {
+		writePRGRAM(cart, address, data);
+		return;
+	}
+
+	((GxROMState *)cart->mapperState)->latch = busConflict(cart, address, data);
+	syncGxROM(cart);
+}
+
+
+// Interface functions
+const Mapper gxromMapper = {
+	MAPPER_GXROM, "GxROM", sizeof(GxROMState), false, initGxROM,
+	readPRGBanks, writePRGGxROM, readCHRBanks, writeCHRBanks,
+	NULL, NULL,
+	syncGxROM
+};
\ No newline at end of file
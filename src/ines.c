@@ -1,5 +1,16 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#endif
 
 #include "ines.h"
 
@@ -9,36 +20,181 @@
 #define HEADER6_4SCREEN 0b00001000
 
 // Useful
-#define CALLOC_REGS(cart) cart->registers = calloc(1, sizeof(uint8_t) * cart->registerCount)
 #define DESTROYPTR(ptr) free(ptr); ptr = NULL
 
+// A .nes file mapped read-only in memory, which PRG and CHR ROM point straight into
+// Every cartridge loaded from the same file shares its mapping, and the mapping itself is backed by the page cache, so ROMs are neither copied nor kept once per instance
+typedef struct ROMImage {
+	uint64_t device, file; // Identify the file, whatever path it was opened with
+	size_t size;
+	const uint8_t *data;
+	int users; // Cartridges pointing into the mapping, which is unmapped when the last one is freed
+	struct ROMImage *next;
+} ROMImage;
+
+static ROMImage *images = NULL;
+static pthread_mutex_t imagesLock = PTHREAD_MUTEX_INITIALIZER;
+
+
+// Non-interface functions
+#ifdef _WIN32
+typedef HANDLE ROMFile;
+#else
+typedef int ROMFile;
+#endif
+
+// Opens the file and identifies it, or returns false if it can't be (or is empty)
+bool openROMFile(const char *path, ROMFile *handle, size_t *size, uint64_t *device, uint64_t *file) {
+#ifdef _WIN32
+	*handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (*handle == INVALID_HANDLE_VALUE)
+		return false;
+	BY_HANDLE_FILE_INFORMATION info;
+	if (!GetFileInformationByHandle(*handle, &info) || (info.nFileSizeLow == 0 && info.nFileSizeHigh == 0)) {
+		CloseHandle(*handle);
+		return false;
+	}
+	*size = ((uint64_t)info.nFileSizeHigh << 32) | info.nFileSizeLow;
+	*device = info.dwVolumeSerialNumber;
+	*file = ((uint64_t)info.nFileIndexHigh << 32) | info.nFileIndexLow;
+#else
+	*handle = open(path, O_RDONLY);
+	if (*handle < 0)
+		return false;
+	struct stat info;
+	if (fstat(*handle, &info) != 0 || info.st_size == 0) {
+		close(*handle);
+		return false;
+	}
+	*size = info.st_size;
+	*device = info.st_dev;
+	*file = info.st_ino;
+#endif
+	return true;
+}
+
+void closeROMFile(ROMFile handle) {
+#ifdef _WIN32
+	CloseHandle(handle);
+#else
+	close(handle);
+#endif
+}
+
+// Maps the whole file, or returns NULL if it can't be
+// The mapping stays valid once the file is closed
+const uint8_t *mapROMFile(ROMFile handle, size_t size) {
+#ifdef _WIN32
+	const uint8_t *data = NULL;
+	HANDLE mapping = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping != NULL) {
+		data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		// The view keeps the mapping alive
+		CloseHandle(mapping);
+	}
+	return data;
+#else
+	const uint8_t *data = mmap(NULL, size, PROT_READ, MAP_SHARED, handle, 0);
+	return (data == MAP_FAILED) ? NULL : data;
+#endif
+}
+
+void unmapROMFile(const uint8_t *data, size_t size) {
+#ifdef _WIN32
+	UnmapViewOfFile(data);
+#else
+	munmap((void *)data, size);
+#endif
+}
+
+// Returns the mapping of the file, which is only created if no other cartridge uses it yet
+ROMImage *acquireROMImage(const char *path) {
+	ROMFile handle;
+	size_t size;
+	uint64_t device, file;
+	if (!openROMFile(path, &handle, &size, &device, &file))
+		return NULL;
+
+	pthread_mutex_lock(&imagesLock);
+	ROMImage *image = images;
+	while (image != NULL && (image->device != device || image->file != file || image->size != size))
+		image = image->next;
+	if (image != NULL) {
+		image->users++;
+	} else {
+		const uint8_t *data = mapROMFile(handle, size);
+		if (data != NULL) {
+			image = malloc(sizeof(ROMImage));
+			if (image == NULL) {
+				unmapROMFile(data, size);
+			} else {
+				image->device = device;
+				image->file = file;
+				image->size = size;
+				image->data = data;
+				image->users = 1;
+				image->next = images;
+				images = image;
+			}
+		}
+	}
+	pthread_mutex_unlock(&imagesLock);
+	closeROMFile(handle);
+	return image;
+}
+
+void releaseROMImage(ROMImage *image) {
+	if (image == NULL)
+		return;
+
+	pthread_mutex_lock(&imagesLock);
+	if (--image->users == 0) {
+		ROMImage **link = &images;
+		while (*link != image)
+			link = &(*link)->next;
+		*link = image->next;
+		unmapROMFile(image->data, image->size);
+		free(image);
+	}
+	pthread_mutex_unlock(&imagesLock);
+}
+
+
+// Interface functions
 void freeCartridge(Cartridge *cart) {
-	DESTROYPTR(cart->PRG);
-	DESTROYPTR(cart->PRG);
-	DESTROYPTR(cart->CHR);
-	DESTROYPTR(cart->registers);
+	// PRG and CHR ROM belong to the mapping of the file
+	if (cart->CHRisRAM)
+		free(cart->CHR);
+	cart->PRG = NULL;
+	cart->CHR = NULL;
+	releaseROMImage(cart->image);
+	cart->image = NULL;
+	DESTROYPTR(cart->CHRtileCache);
 	DESTROYPTR(cart->persistentRAM);
+	DESTROYPTR(cart->extraVRAM);
+	freeMapper(cart);
 }
 
+// PRG and CHR ROM point into the mapped file, so they must never be written to
 int loadROMFromFile(Cartridge *cart, const char *path, bool printDetails) {
 	if (printDetails) printf("Cartridge details:\n");
 
-	FILE *input = fopen(path, "rb");
-	if (input == NULL) {
+	ROMImage *image = acquireROMImage(path);
+	if (image == NULL) {
 		if (printDetails) printf("\tError: couldn't open file.\n");
 		return -0x01;
 	}
 
-	uint8_t flags[16];
-	if (fread(flags, sizeof(uint8_t), 16, input) != 16) {
+	const uint8_t *flags = image->data;
+	if (image->size < 16) {
 		if (printDetails) printf("\tError: corrupted file does not contain flags.\n");
-		fclose(input);
+		releaseROMImage(image);
 		return -0x02;
 	}
 
 	if (flags[0] != 'N' || flags[1] != 'E' || flags[2] != 'S' || flags[3] != 0x1A) {
 		if (printDetails) printf("\tError: invalid file does not contain NES header.\n");
-		fclose(input);
+		releaseROMImage(image);
 		return -0x03;
 	}
 
@@ -46,7 +202,12 @@ int loadROMFromFile(Cartridge *cart, const char *path, bool printDetails) {
 	cart->CHRsize = flags[5] * 0x2000;
 	cart->mapperID = flags[6] >> 4;
 	cart->mapperID |= flags[7] & 0b11110000;
-	cart->persistentRAM = NULL;
+	cart->PRG = cart->CHR = cart->persistentRAM = NULL;
+	cart->image = image;
+	cart->CHRtileCache = NULL;
+	cart->extraVRAM = NULL;
+	cart->mapperState = NULL;
+	cart->irqOut = false;
 	cart->CHRisRAM = false;
 
 	if (printDetails) {
@@ -55,33 +216,27 @@ int loadROMFromFile(Cartridge *cart, const char *path, bool printDetails) {
 		printf("\tMapper ID: %i\n", cart->mapperID);
 	}
 
+	// Every access to cartridge space goes straight to the mapper from now on
+	cart->mapper = findMapper(cart->mapperID);
+	if (cart->mapper == NULL) {
+		if (printDetails) printf("\tError: Mapper not supported.\n");
+		freeCartridge(cart);
+		return -0x05;
+	}
+	if (printDetails) printf("\tMapper: %s\n", cart->mapper->name);
+
 	// TODO select option for random- / 0- / 1- filled RAM (both PRG and CHR (below))
-	if (flags[6] & HEADER6_NONVOLATILE) {
+	// The trainer is loaded to PRG RAM, so it needs some
+	if ((flags[6] & (HEADER6_NONVOLATILE | HEADER6_TRAINER)) || cart->mapper->PRGRAM) {
 		cart->persistentRAM = malloc(0x2000 * sizeof(uint8_t));
 		if (!cart->persistentRAM) {
 			if (printDetails) printf("\tError: couldn't allocate memory for persistent RAM.\n");
-			fclose(input);
+			freeCartridge(cart);
 			return -0x06;
 		}
 
-		printf("\tNOTE: Presence of non-volatile memory (defaults to 2KiB battery-backed PRG RAM)\n");
-	}
-
-	switch (cart->mapperID) {
-		case MAPPER_NROM:
-			cart->registerCount = 0;
-			cart->registers = NULL;
-			break;
-		case MAPPER_MMC1:
-			cart->registerCount = 6;
-			CALLOC_REGS(cart);
-			cart->registers[MMC1_REG_SHIFT] = MMC1_REG_SHIFT_DEFAULTVALUE;
-			cart->registers[MMC1_REG_CTRL] = MMC1_REG_CTRL_DEFAULTVALUE;
-			break;
-		default:
-			if (printDetails) printf("\tError: Mapper not supported.\n");
-			fclose(input);
-			return -0x05;
+		if (flags[6] & HEADER6_NONVOLATILE)
+			printf("\tNOTE: Presence of non-volatile memory (defaults to 2KiB battery-backed PRG RAM)\n");
 	}
 
 	cart->mirroringType = (flags[6] & HEADER6_MIRRORING ? MIRROR_VERTICAL : MIRROR_HORIZONTAL);
@@ -97,46 +252,67 @@ int loadROMFromFile(Cartridge *cart, const char *path, bool printDetails) {
 		}
 	}
 
-	// TODO nametable mirroring
+	if (cart->mirroringType == MIRROR_4SCREEN) {
+		// The other two nametables are on the cartridge
+		cart->extraVRAM = calloc(0x0800, sizeof(uint8_t));
+		if (!cart->extraVRAM) {
+			if (printDetails) printf("\tError: couldn't allocate memory for four-screen VRAM.\n");
+			freeCartridge(cart);
+			return -0x04;
+		}
+	}
 
+	size_t offset = 16;
 	if (flags[6] & HEADER6_TRAINER) {
-		uint8_t trainer[512];
-		if (fread(flags, sizeof(uint8_t), 512, input) != 512) {
+		if (image->size < offset + 512) {
 			if (printDetails) printf("\tError: Corrupted file does not contain 512B trainer when indicated in header.\n");
 			freeCartridge(cart);
-			fclose(input);
 			return -0x02;
 		}
-		if (printDetails) printf("\tNOTE: Presence of 512B trainer (currently unsupported).\n");
+		memcpy(&cart->persistentRAM[0x1000], &image->data[offset], 512);
+		offset += 512;
+		if (printDetails) printf("\tNOTE: Presence of 512B trainer (loaded to 0x7000).\n");
 	}
 
-	// TODO error handling is the absolute worst
-	cart->PRG = malloc(cart->PRGsize);
+	if (image->size < offset + cart->PRGsize + (cart->CHRsize == 0 ? 0 : cart->CHRsize)) {
+		if (printDetails) printf("\tError: corrupted file does not contain the valid amount of PRG or CHR.\n");
+		freeCartridge(cart);
+		return -0x02;
+	}
+
+	cart->PRG = &image->data[offset];
 	if (cart->CHRsize == 0) {
 		cart->CHRisRAM = true;
 		cart->CHRsize = 0x2000;
-		printf("\tNOTE: CHR (of size 0B) replaced with writeable CHR RAM of size 2KiB.\n");
+		printf("\tNOTE: CHR (of size 0B) replaced with writeable CHR RAM of size 8KiB.\n");
+		cart->CHR = malloc(cart->CHRsize);
+		if (!cart->CHR) {
+			if (printDetails) printf("\tError: couldn't allocate memory for CHR RAM.\n");
+			freeCartridge(cart);
+			return -0x04;
+		}
+	} else {
+		// Only ever written to when it is RAM (see writePatternRAM)
+		cart->CHR = (uint8_t *)&image->data[offset + cart->PRGsize];
 	}
 
-	cart->CHR = malloc(cart->CHRsize);
-	if (!cart->PRG || !cart->CHR) {
-		if (printDetails) printf("\tError: couldn't allocate memory for PRG or CHR.\n");
+	// Two pre-decoded copies (normal and mirrored) of 2 bytes for every 2 bytes of CHR
+	cart->CHRtileCache = malloc(cart->CHRsize * sizeof(uint16_t));
+	if (!cart->CHRtileCache) {
+		if (printDetails) printf("\tError: couldn't allocate memory for CHR tile cache.\n");
 		freeCartridge(cart);
-		fclose(input);
 		return -0x04;
 	}
 
-	uint8_t status = (fread(cart->PRG, sizeof(uint8_t), cart->PRGsize, input) != cart->PRGsize);
-	if (!cart->CHRisRAM) {
-		status |= (fread(cart->CHR, sizeof(uint8_t), cart->CHRsize, input) != cart->CHRsize);
-	}
-
-	fclose(input);
+	for (uint32_t i = 0; i < cart->CHRsize >> 1; i++)
+		decodeTileRow(cart, i);
 
-	if (status) {
-		if (printDetails) printf("\tError: corrupted file does not contain the valid amount of PRG or CHR.\n");
+	// Until the mapper changes it, if it can
+	setMirroring(cart, cart->mirroringType);
+	if (initMapper(cart, cart->mapper) != 0) {
+		if (printDetails) printf("\tError: couldn't allocate memory for mapper state.\n");
 		freeCartridge(cart);
-		return -0x02;
+		return -0x04;
 	}
 
 	return 0x00;
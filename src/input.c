@@ -9,6 +9,7 @@ void initPort(Port *port, uint8_t type, GLFWwindow *window, int *scancodes, int
 	port->window = window;
 	port->control = PORT_STROBE; // TODO check default value
 	port->currentKey = 0;
+	port->buttons = 0;
 
 	mapKeys(port, scancodes, scancodeCount);
 }
@@ -23,10 +24,11 @@ bool mapKeys(Port *port, int *keys, int count) {
 }
 
 uint8_t readController(Port *port) {
+	const uint32_t buttons = __atomic_load_n(&port->buttons, __ATOMIC_RELAXED);
 	uint8_t data = 0;
 	if (port->keyCount > 0) {
 		if (port->control & PORT_STROBE) {
-			data = (glfwGetKey(port->window, port->keys[0]) == GLFW_PRESS);
+			data = buttons & 1;
 		} else {
 			data = port->reg & 1;
 			port->reg >>= 1;
@@ -36,7 +38,7 @@ uint8_t readController(Port *port) {
 			}
 		}
 	}
-	if (glfwGetKey(port->window, GLFW_KEY_P)) {
+	if (buttons & PORT_DEBUGALL) {
 		// TODO remove this
 		data = 0xFF;
 	}
@@ -48,11 +50,19 @@ void writeController(Port *port, uint8_t data) {
 		// On an original NES controllers (and many other input controllers), the buttons are continuously fed into the internal register while STROBE is high.
 		// However, there isn't much to benefit from reading input every frame, as, while STROBE is high, the register isn't shifting to bits other than the first (A), so we just update the register when writing when STROBE is high.
 		port->currentKey = 0;
-		port->reg = 0;
-		for (int i = 0; i < port->keyCount; i++) {
-			port->reg |= (glfwGetKey(port->window, port->keys[i]) << i);
-		}
+		port->reg = __atomic_load_n(&port->buttons, __ATOMIC_RELAXED) & ~PORT_DEBUGALL;
 	}
 
 	port->control = data;
+}
+
+// Reads the mapped keys for the emulation thread, which reads them back in readController and writeController
+// Must be called from the thread handling the window (after polling events)
+void pollPort(Port *port) {
+	uint32_t buttons = 0;
+	for (int i = 0; i < port->keyCount; i++)
+		buttons |= (glfwGetKey(port->window, port->keys[i]) == GLFW_PRESS) << i;
+	if (port->window != NULL && glfwGetKey(port->window, GLFW_KEY_P) == GLFW_PRESS)
+		buttons |= PORT_DEBUGALL;
+	__atomic_store_n(&port->buttons, buttons, __ATOMIC_RELAXED);
 }
\ No newline at end of file
@@ -12,12 +12,19 @@
 
 #define PORT_STROBE 0b1
 
+// Set in the forwarded buttons along with the mapped keys while P is held, to read all buttons as pressed
+// TODO remove this
+#define PORT_DEBUGALL 0x80000000
+
 typedef struct Port {
 	uint8_t inputType;
 	uint8_t control;
 	uint32_t reg;
 	uint8_t currentKey;
 
+	// The keyboard can only be read by the thread handling the window, so it forwards the state of the keys (bit n for keys[n]) with pollPort
+	uint32_t buttons;
+
 	GLFWwindow *window;
 	int *keys;
 	int keyCount;
@@ -28,5 +35,6 @@ void initPort(Port *port, uint8_t type, GLFWwindow *window, int *keys, int keyCo
 bool mapKeys(Port *port, int *keys, int count);
 uint8_t readController(Port *port);
 void writeController(Port *port, uint8_t data);
+void pollPort(Port *port);
 
 #endif // ifndef INPUT_H
\ No newline at end of file
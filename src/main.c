@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "GL/glew.h"
 #include "GLFW/glfw3.h"
@@ -10,21 +11,40 @@
 #include "cpu.h"
 #include "ppu.h"
 #include "apu.h"
+#include "apulog.h"
 #include "ines.h"
 #include "audio.h"
+#include "raster.h"
+#include "frames.h"
+#include "pacing.h"
+#include "capture.h"
+
+#include <pthread.h>
 
 #ifdef _WIN32
 #include <Windows.h>
-#else
-#include <time.h>
 #endif
 
 // Number of pixels on the x and y axies
-#define HEIGHT_PIXELS 240
-#define WIDTH_PIXELS 256
+#define HEIGHT_PIXELS FRAME_HEIGHT
+#define WIDTH_PIXELS FRAME_WIDTH
+
+// Number of worker threads composing frames after they are emulated
+#define RASTER_THREADS 2
+
+// NTSC frame rate: 1789773 Hz CPU clock, 29780.5 CPU cycles per frame (on average, as odd frames are a dot shorter)
+#define NES_FRAMERATE 60.0988
 
-#define WIN32_TIMERESOLUTION 2
-#define UNIX_TIMERESOLUTION 2000
+// In vsync-locked mode, the refresh rate of the monitor must be within VSYNC_TOLERANCE of NES_FRAMERATE, as that's the most the audio resampling ratio is adjusted by (see audio.c)
+#define VSYNC_TOLERANCE 0.005
+#define VSYNC_MAXLAG 3
+// Swapping buffers doesn't wait for vsync if the driver forces it off or the window is hidden, and then doesn't keep time
+// A swap returning sooner than VSYNC_FASTSWAP refresh periods after the previous one didn't wait, and isn't signaled as a vsync; after VSYNC_MAXFASTSWAPS of them in a row, emulation falls back to the timer
+#define VSYNC_FASTSWAP 0.5
+#define VSYNC_MAXFASTSWAPS 30
+
+// Resolution of Sleep on Windows, in milliseconds (see pacing.c)
+#define WIN32_TIMERESOLUTION 1
 
 // Initial window dimensions
 #define WINDOW_HEIGHT HEIGHT_PIXELS * 4
@@ -44,17 +64,202 @@ void callbackErrorGLFW(int code, const char *description) {
 	printf("GLFW Error %i : %s\n", code, description);
 }
 
+// Frames that didn't change aren't presented, unless the contents of the window have to be drawn again
+bool windowDamaged = true;
+
 void callbackFrameBufferSize(GLFWwindow *window, int width, int height) {
 	glViewport(0, 0, width, height);
+	windowDamaged = true;
+}
+
+void callbackWindowRefresh(GLFWwindow *window) {
+	windowDamaged = true;
+}
+
+// Called on the audio thread once it synthesized a frame
+void queueFrameSamples(void *engine, Blip *blip) {
+	queueSamples((AudioEngine *)engine, blip);
+}
+
+// Everything the emulation thread works with
+typedef struct Emulation {
+	CPU *cpu;
+	PPU *ppu;
+	APU *apu;
+	AudioEngine *engine;
+	Rasterizer *raster;
+	TripleBuffer *frames;
+	Capture *capture; // Gets every frame completed, if set
+
+	bool quit;
+
+	// In vsync-locked mode, a frame is emulated every time the main thread signals a vsync (after swapping buffers), until the main thread falls back to the timer (see unlockVsync)
+	bool vsyncLocked;
+	pthread_mutex_t vsyncLock;
+	pthread_cond_t vsyncSignal;
+	uint64_t vsyncCount;
+
+	// Only touched by the emulation thread until it is joined
+	FrameTimes emulationTimes; // Time spent emulating each frame
+	FrameTimes frameIntervals; // Time between two completed frames
+	double lastCompleted;
+	Pacer pacer; // Only used when not locked to vsync
+} Emulation;
+
+// Emulates a single frame and hands it to the presenting thread
+void emulateFrame(Emulation *emulation) {
+	CPU *cpu = emulation->cpu;
+	PPU *ppu = emulation->ppu;
+	APU *apu = emulation->apu;
+
+	const double frameStart = glfwGetTime();
+	while (!ppu->frameDone) {
+		// TODO the CPU / PPU alignment is weird
+		tickPPU(ppu);
+		tickPPU(ppu);
+		// PHI2
+		cpu->NMIPin = ppu->outInterrupt;
+		// The APU only runs when the CPU accesses it, when its frame IRQ is due and at the end of the frame
+		if (cpu->cycleCount >= apu->irqClock)
+			runAPU(apu, cpu->cycleCount);
+		cpu->IRQPin = !(apu->irqOutDMC || apu->irqOutFrame || cpu->bus->cartridge->irqOut);
+		pollInterrupts(cpu);
+		tickPPU(ppu);
+		// PHI1
+		tickCPU(cpu);
+	}
+	ppu->frameDone = false;
+	endFrameAPU(apu, cpu->cycleCount);
+	if (apu->log == NULL && apu->blip != NULL)
+		queueSamples(emulation->engine, apu->blip);
+
+	// The frame is complete once the rasterizer is done with it, and the next one is emulated into the frame given back by the triple buffer
+	if (emulation->raster != NULL)
+		waitRaster(emulation->raster);
+	Frame *frame = &emulation->frames->frames[emulation->frames->writing];
+	hashFramePPU(ppu, frame->lineHashes);
+	frame->completed = glfwGetTime();
+	if (emulation->capture != NULL)
+		captureFrame(emulation->capture, frame);
+	setFramebufferPPU(ppu, publishFrame(emulation->frames)->pixels);
+	glfwPostEmptyEvent();
+
+	addFrameTime(&emulation->emulationTimes, frame->completed - frameStart);
+	addFrameTime(&emulation->frameIntervals, frame->completed - emulation->lastCompleted);
+	emulation->lastCompleted = frame->completed;
+}
+
+// Emulates frames at the NES frame rate, or on every vsync in vsync-locked mode, handing each of them to the presenting thread as soon as it is complete
+// Presenting (and especially waiting for vsync) never stalls emulation: the presenting thread simply takes the newest frame whenever it is ready for one
+// Either way, audio and video drift apart slowly (the display or the timer isn't exactly at the NES frame rate, and neither is the audio device at its sample rate), which the audio engine absorbs by adjusting its resampling ratio
+void *emulate(void *arg) {
+	Emulation *emulation = (Emulation *)arg;
+	emulation->lastCompleted = glfwGetTime();
+
+	uint64_t framesEmulated = 0;
+	pthread_mutex_lock(&emulation->vsyncLock);
+	while (emulation->vsyncLocked && !emulation->quit) {
+		while (emulation->vsyncCount == framesEmulated && emulation->vsyncLocked && !emulation->quit)
+			pthread_cond_wait(&emulation->vsyncSignal, &emulation->vsyncLock);
+		if (!emulation->vsyncLocked || emulation->quit)
+			break;
+		// After a hiccup, vsyncs that were missed by more than VSYNC_MAXLAG frames are dropped rather than caught up on
+		if (emulation->vsyncCount - framesEmulated > VSYNC_MAXLAG)
+			framesEmulated = emulation->vsyncCount - VSYNC_MAXLAG;
+		pthread_mutex_unlock(&emulation->vsyncLock);
+
+		emulateFrame(emulation);
+		framesEmulated++;
+
+		pthread_mutex_lock(&emulation->vsyncLock);
+	}
+	pthread_mutex_unlock(&emulation->vsyncLock);
+
+	// Without vsync (or once it is given up on), sleeps until shortly before each frame starts, so the thread only uses a core for emulation itself
+	initPacer(&emulation->pacer, 1.0 / NES_FRAMERATE);
+	while (!__atomic_load_n(&emulation->quit, __ATOMIC_RELAXED)) {
+		waitNextFrame(&emulation->pacer);
+		emulateFrame(emulation);
+	}
+
+	return NULL;
+}
+
+// The main thread signals every vsync to the emulation thread in vsync-locked mode
+void signalVsync(Emulation *emulation) {
+	pthread_mutex_lock(&emulation->vsyncLock);
+	emulation->vsyncCount++;
+	pthread_cond_signal(&emulation->vsyncSignal);
+	pthread_mutex_unlock(&emulation->vsyncLock);
+}
+
+// Emulation goes on with the timer, when swapping buffers turns out not to wait for vsync
+void unlockVsync(Emulation *emulation) {
+	pthread_mutex_lock(&emulation->vsyncLock);
+	emulation->vsyncLocked = false;
+	pthread_cond_signal(&emulation->vsyncSignal);
+	pthread_mutex_unlock(&emulation->vsyncLock);
+}
+
+void stopEmulation(Emulation *emulation) {
+	pthread_mutex_lock(&emulation->vsyncLock);
+	__atomic_store_n(&emulation->quit, true, __ATOMIC_RELAXED);
+	pthread_cond_signal(&emulation->vsyncSignal);
+	pthread_mutex_unlock(&emulation->vsyncLock);
 }
 
 int main(int argc, char *argv[]) {
 	printf("NESRev v3.6\n");
 
-	if (argc != 2) {
-		printf("Usage : nesrev rom\n");
+	// Options come before the ROM
+	bool vsyncLocked = false;
+#ifdef NESREV_NOAUDIO
+	const AudioSink *sink = &nullSink;
+#else
+	const AudioSink *sink = &portaudioSink;
+#endif
+	const char *audioPath = NULL;
+	const char *captureVideoPath = NULL, *captureAudioPath = NULL;
+	CaptureFormat captureFormat = CAPTURE_Y4M;
+	bool captureDeduplicate = false;
+	for (int i = 1; i < argc - 1; i++) {
+		if (strcmp(argv[i], "--vsync") == 0) {
+			vsyncLocked = true;
+		} else if (strcmp(argv[i], "--capture-video") == 0 && i + 1 < argc - 1) {
+			// The format comes before the file, e.g. y4m:out.y4m
+			char *separator = strchr(argv[++i], ':');
+			if (separator == NULL || (strncmp(argv[i], "y4m:", 4) != 0 && strncmp(argv[i], "rgb:", 4) != 0)) {
+				argc = 0;
+				break;
+			}
+			captureFormat = (argv[i][0] == 'y') ? CAPTURE_Y4M : CAPTURE_RGB;
+			captureVideoPath = separator + 1;
+		} else if (strcmp(argv[i], "--capture-audio") == 0 && i + 1 < argc - 1) {
+			captureAudioPath = argv[++i];
+		} else if (strcmp(argv[i], "--capture-dedup") == 0) {
+			captureDeduplicate = true;
+		} else if (strcmp(argv[i], "--audio") == 0 && i + 1 < argc - 1) {
+			// The sink's name can be followed by the file it writes to, e.g. wav:out.wav
+			char *separator = strchr(argv[++i], ':');
+			if (separator != NULL) {
+				*separator = '\0';
+				audioPath = separator + 1;
+			}
+			sink = findAudioSink(argv[i]);
+			if (sink == NULL) {
+				argc = 0;
+				break;
+			}
+		} else {
+			argc = 0;
+			break;
+		}
+	}
+	if (argc < 2) {
+		printf("Usage : nesrev [--vsync] [--audio portaudio | null | wav:file | raw:file] [--capture-video y4m:file | rgb:file] [--capture-audio file] [--capture-dedup] rom\n");
 		return -0x08;
 	}
+	const char *romPath = argv[argc - 1];
 
 	// To clarify why OpenGL / GLFW / GLUT setup isn't handled by an interface function :
 	// The main function directly needs the GLFW window in order to process input and check if the main loop should continue.
@@ -77,6 +282,7 @@ int main(int argc, char *argv[]) {
 	}
 	glViewport(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
 	glfwSetFramebufferSizeCallback(window, callbackFrameBufferSize);
+	glfwSetWindowRefreshCallback(window, callbackWindowRefresh);
 	glfwMakeContextCurrent(window);
 
 	// Initializes GLEW
@@ -89,16 +295,16 @@ int main(int argc, char *argv[]) {
 	glEnable(GL_DEBUG_OUTPUT);
 	glDebugMessageCallback(callbackErrorGL, NULL);
 
-	const Context context = setupContext(WIDTH_PIXELS, HEIGHT_PIXELS);
+	Context context = setupContext(WIDTH_PIXELS, HEIGHT_PIXELS);
 	if (context.status == false) {
 		printf("Fatal error : couldn't set up shader communication with GPU.\n");
 		glfwTerminate();
 		return -0x05;
 	}
 
-	// Array is dynamically allocated to avoid stack depletion and allow dynamic resolution
-	uint8_t *colors = malloc(sizeof(uint8_t) * HEIGHT_PIXELS * WIDTH_PIXELS * COLOR_COMPONENTS);
-	if (colors == NULL) {
+	// Frames are dynamically allocated to avoid stack depletion
+	TripleBuffer *frames = malloc(sizeof(TripleBuffer));
+	if (frames == NULL) {
 		printf("Fatal error : couldn't allocate enough memory.\n");
 		terminateContext(context);
 		glfwTerminate();
@@ -122,21 +328,59 @@ int main(int argc, char *argv[]) {
 	Cartridge cart;
 	initBus(&bus, &cpu, &ppu, &apu, ports, &cart);
 	initCPU(&cpu, &bus);
-	initPPU(&ppu, colors, &bus);
+	initTripleBuffer(frames);
+	initPPU(&ppu, frames->frames[frames->writing].pixels, &bus);
 	initAPU(&apu);
 	initPort(&ports[0], PORT_STDCONTROLLER, window, keys, 8);
 	initPort(&ports[1], PORT_NONE, window, NULL, 0);
 
+	// If worker threads can't be created, pixels are simply composed during emulation
+	Rasterizer *raster = malloc(sizeof(Rasterizer));
+	if (raster != NULL && initRasterizer(raster, ppu.framebuffer, RASTER_THREADS) != 0) {
+		free(raster);
+		raster = NULL;
+	}
+	setRasterizerPPU(&ppu, raster);
+
 	AudioEngine engine;
-	initAudioEngine(&engine);
+	if (initAudioEngine(&engine, sink, audioPath) != 0)
+		printf("Error : couldn't open the %s audio sink, sound is disabled.\n", sink->name);
+
+	// Sound is synthesized on its own thread from the writes to the APU's registers; if it can't be created, the APU simply runs on the emulation thread
+	// When it is thrown away (and not captured), it isn't synthesized at all, and the APU only runs as a shadow
+	Blip blip;
+	APULog *apuLog = NULL;
+	if (engine.sink->output || captureAudioPath != NULL) {
+		apuLog = malloc(sizeof(APULog));
+		if (apuLog != NULL && initAPULog(apuLog, SOURCE_CLOCK_RATE, SYNTHESIS_RATE, queueFrameSamples, &engine) != 0) {
+			free(apuLog);
+			apuLog = NULL;
+		}
+		if (apuLog != NULL) {
+			setLogAPU(&apu, apuLog);
+		} else {
+			initBlip(&blip, SOURCE_CLOCK_RATE, SYNTHESIS_RATE);
+			setBlipAPU(&apu, &blip);
+		}
+	}
 
-	if (loadROMFromFile(&cart, argv[1], true) != 0) {
+	if (loadROMFromFile(&cart, romPath, true) != 0) {
 		printf("Fatal error : couldn't load ROM.\n");
+		if (raster != NULL) {
+			terminateRasterizer(raster);
+			free(raster);
+		}
+		if (apuLog != NULL) {
+			terminateAPULog(apuLog);
+			free(apuLog);
+		}
+		free(frames);
 		terminateContext(context);
 		terminateAudioEngine(&engine);
 		glfwTerminate();
 		return -0x09;
 	}
+	setA12HooksPPU(&ppu, cart.mapper->scanline != NULL);
 
 	// Debug logging
 	// With the provided Makefile, NESREV_DEBUG is always defined according to an environment variable
@@ -152,10 +396,13 @@ int main(int argc, char *argv[]) {
 	}
 	setLogCPU(&cpu, NESREV_DEBUG, logFile);
 
-	// Palette information is stored in .pal files (no header, 3-byte RGB for each of 64 palette colors)
-	FILE *paletteFile = fopen("default.pal", "r");
-	uint8_t palette[0x40 * 3];
-	if (fread(palette, sizeof(uint8_t), 0x40 * 3, paletteFile) != 0x40 * 3) {
+	// Palette information is stored in .pal files (no header, 3-byte RGB for each of 64 palette colors, optionally followed by the same for each of the 7 emphasis combinations)
+	FILE *paletteFile = fopen("default.pal", "rb");
+	uint8_t palette[PALETTE_EMPHASIS_LEVELS * PALETTE_COLORS * COLOR_COMPONENTS];
+	size_t paletteSize = 0;
+	if (paletteFile != NULL)
+		paletteSize = fread(palette, sizeof(uint8_t), PALETTE_EMPHASIS_LEVELS * PALETTE_COLORS * COLOR_COMPONENTS, paletteFile);
+	if (paletteSize != PALETTE_COLORS * COLOR_COMPONENTS && paletteSize != PALETTE_EMPHASIS_LEVELS * PALETTE_COLORS * COLOR_COMPONENTS) {
 		printf("Fatal error : corrupted default palette file (default.pal).\n");
 		if (paletteFile != NULL) {
 			fclose(paletteFile);
@@ -164,9 +411,18 @@ int main(int argc, char *argv[]) {
 		if (logFile != NULL) {
 			fclose(logFile);
 		}
-		free(colors);
+		if (raster != NULL) {
+			terminateRasterizer(raster);
+			free(raster);
+		}
+		if (apuLog != NULL) {
+			terminateAPULog(apuLog);
+			free(apuLog);
+		}
+		free(frames);
 		freeCartridge(&cart);
 		terminateContext(context);
+		terminateAudioEngine(&engine);
 		glfwTerminate();
 		return -0x04;
 	}
@@ -175,10 +431,19 @@ int main(int argc, char *argv[]) {
 		fclose(paletteFile);
 	}
 
-	loadPalette(&ppu, palette);
+	setPalette(context, palette, paletteSize / COLOR_COMPONENTS);
 
-	double frameDuration = 1.0f / 60;
-	double frameStart = glfwGetTime();
+	// Frames and sound are captured on their own thread, which emulation only waits for if it falls behind
+	Capture *capture = NULL;
+	if (captureVideoPath != NULL || captureAudioPath != NULL) {
+		capture = malloc(sizeof(Capture));
+		if (capture == NULL || initCapture(capture, captureVideoPath, captureFormat, captureAudioPath, palette, paletteSize / COLOR_COMPONENTS, captureDeduplicate) != 0) {
+			printf("Error : couldn't start capturing, nothing will be recorded.\n");
+			free(capture);
+			capture = NULL;
+		}
+		setCaptureAudio(&engine, capture);
+	}
 
 #ifdef _WIN32
 	timeBeginPeriod(WIN32_TIMERESOLUTION);
@@ -186,49 +451,124 @@ int main(int argc, char *argv[]) {
 
 	startStream(&engine);
 
-	while (!glfwWindowShouldClose(window)) {
+	// Vsync-locked mode only makes sense when the monitor refreshes at about the NES frame rate
+	const GLFWvidmode *videoMode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+	if (vsyncLocked && (videoMode == NULL || videoMode->refreshRate < NES_FRAMERATE * (1 - VSYNC_TOLERANCE) || videoMode->refreshRate > NES_FRAMERATE * (1 + VSYNC_TOLERANCE))) {
+		printf("Error : the refresh rate of the monitor is too far from %.4f Hz to lock emulation to vsync, using a timer instead.\n", NES_FRAMERATE);
+		vsyncLocked = false;
+	}
 
-		if (glfwGetTime() - frameStart >= frameDuration) {
-			frameStart = glfwGetTime();
-			for (int i = 0; i < 29781 - (ppu.oddFrame); i++) {
-				// TODO the CPU / PPU alignment is weird
-				tickPPU(&ppu);
-				tickPPU(&ppu);
-				// PHI2
-				cpu.NMIPin = ppu.outInterrupt;
-				cpu.IRQPin = !(apu.irqOutDMC || apu.irqOutFrame);
-				// TODO IRQ is broken
-				pollInterrupts(&cpu);
-				tickPPU(&ppu);
-				// PHI1
-				tickCPU(&cpu);
-				tickAPU(&apu);
-				newSamplef(&engine, apu.currentSample);
-			}
+	Emulation emulation = {&cpu, &ppu, &apu, &engine, raster, frames, capture, false, vsyncLocked};
+	pthread_mutex_init(&emulation.vsyncLock, NULL);
+	pthread_cond_init(&emulation.vsyncSignal, NULL);
+	emulation.vsyncCount = 0;
+	initFrameTimes(&emulation.emulationTimes, "Frame emulation");
+	initFrameTimes(&emulation.frameIntervals, "Frame completion interval");
+	pthread_t emulationThread;
+	bool emulating = pthread_create(&emulationThread, NULL, emulate, &emulation) == 0;
+	if (!emulating) {
+		printf("Fatal error : couldn't create emulation thread.\n");
+		glfwSetWindowShouldClose(window, true);
+	}
 
-			draw(context, WIDTH_PIXELS, HEIGHT_PIXELS, colors);
-			glfwSwapBuffers(window);
+	// Emulation runs on its own thread, so this thread only waits for events and frames, and can wait for vsync without stalling emulation
+	glfwSwapInterval(1);
+	FrameTimes presentIntervals, latencies;
+	initFrameTimes(&presentIntervals, "Frame presentation interval");
+	initFrameTimes(&latencies, "Frame latency (completion to presentation)");
+	double lastPresented = glfwGetTime();
+	const double refreshPeriod = vsyncLocked ? 1.0 / videoMode->refreshRate : 0.0;
+	double lastVsync = lastPresented;
+	int fastSwaps = 0;
+
+	// Last frame taken, scanlines that changed since the last frame presented, and statistics on what was actually sent to the GPU
+	const Frame *frame = NULL;
+	uint64_t presentedHashes[HEIGHT_PIXELS] = {0};
+	bool dirtyLines[HEIGHT_PIXELS];
+	unsigned long long framesPresented = 0, framesTaken = 0;
+	while (!glfwWindowShouldClose(window)) {
+		// Woken up by input, or by the emulation thread once a frame is complete
+		// In vsync-locked mode, swapping buffers is what keeps time, so there is no waiting for anything else
+		if (vsyncLocked)
 			glfwPollEvents();
+		else
+			glfwWaitEvents();
+		pollPort(&ports[0]);
+		pollPort(&ports[1]);
+
+		const Frame *newFrame = takeFrame(frames);
+		int dirtyCount = 0;
+		if (newFrame != NULL) {
+			frame = newFrame;
+			framesTaken++;
+			dirtyCount = findDirtyLines(frame, presentedHashes, dirtyLines);
+		}
+		if (!vsyncLocked && (frame == NULL || (dirtyCount == 0 && !windowDamaged)))
+			continue;
+		if (newFrame == NULL) {
+			// Only the window needs to be drawn again
+			for (int i = 0; i < HEIGHT_PIXELS; i++)
+				dirtyLines[i] = false;
+		}
 
-#ifdef _WIN32
-			while (frameDuration - (glfwGetTime() - frameStart) > 4.0f / 1000) {
-				// Sleep by 2ms intervals while there is less than 4ms to wait
-				// TODO make this variable
-				Sleep(WIN32_TIMERESOLUTION);
-			}
-#else
-			while (frameDuration - (glfwGetTime() - frameStart) > 4.0f / 1000) {
-				struct timespec sleepTime;
-				sleepTime.tv_sec = 0;
-				sleepTime.tv_nsec = UNIX_TIMERESOLUTION;
-				// For now, same as Windows
-				nanosleep(&sleepTime, NULL);
+		if (frame != NULL) {
+			draw(&context, frame->pixels, dirtyLines);
+		} else {
+			glClear(GL_COLOR_BUFFER_BIT);
+		}
+		glfwSwapBuffers(window);
+		windowDamaged = false;
+		framesPresented++;
+
+		const double now = glfwGetTime();
+		if (vsyncLocked) {
+			if (now - lastVsync >= refreshPeriod * VSYNC_FASTSWAP) {
+				signalVsync(&emulation);
+				lastVsync = now;
+				fastSwaps = 0;
+			} else if (++fastSwaps >= VSYNC_MAXFASTSWAPS) {
+				printf("Error : swapping buffers doesn't wait for vsync, using a timer instead.\n");
+				vsyncLocked = false;
+				unlockVsync(&emulation);
 			}
-#endif
 		}
+
+		addFrameTime(&presentIntervals, now - lastPresented);
+		if (newFrame != NULL)
+			addFrameTime(&latencies, now - frame->completed);
+		lastPresented = now;
 	}
 
+	if (emulating) {
+		stopEmulation(&emulation);
+		pthread_join(emulationThread, NULL);
+	}
+	pthread_cond_destroy(&emulation.vsyncSignal);
+	pthread_mutex_destroy(&emulation.vsyncLock);
+
+	// The audio thread replays what is left of the log before stopping
+	if (apuLog != NULL) {
+		terminateAPULog(apuLog);
+		printAPULog(apuLog);
+		free(apuLog);
+	}
+	// Everything captured is written before the writer thread stops
+	if (capture != NULL) {
+		terminateCapture(capture);
+		printCapture(capture);
+		free(capture);
+	}
 	stopStream(&engine);
+	printAudioEngine(&engine);
+
+	if (framesTaken > 0)
+		printf("%llu frames presented out of %llu taken, %.1f KiB uploaded per frame on average.\n", framesPresented, framesTaken, context.uploadedBytes / 1024.0 / framesTaken);
+	if (emulating && !vsyncLocked)
+		printPacer(&emulation.pacer);
+	printFrameTimes(&emulation.emulationTimes);
+	printFrameTimes(&emulation.frameIntervals);
+	printFrameTimes(&presentIntervals);
+	printFrameTimes(&latencies);
 
 #ifdef _WIN32
 	timeEndPeriod(WIN32_TIMERESOLUTION);
@@ -238,7 +578,11 @@ int main(int argc, char *argv[]) {
 		fclose(logFile);
 	}
 
-	free(colors);
+	if (raster != NULL) {
+		terminateRasterizer(raster);
+		free(raster);
+	}
+	free(frames);
 	freeCartridge(&cart);
 
 	terminateAudioEngine(&engine);
@@ -0,0 +1,59 @@
+#include "mapper.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "cartridge.h"
+
+const Mapper *mappers[] = {
+	&nromMapper,
+	&mmc1Mapper,
+	&mmc3Mapper,
+	&uxromMapper,
+	&cnromMapper,
+	&axromMapper,
+	&gxromMapper,
+	&colorDreamsMapper
+};
+
+
+// Interface functions
+// Returns the mapper with the given iNES number, NULL if it isn't supported
+const Mapper *findMapper(uint16_t id) {
+	for (size_t i = 0; i < sizeof(mappers) / sizeof(mappers[0]); i++) {
+		if (mappers[i]->id == id)
+			return mappers[i];
+	}
+	return NULL;
+}
+
+// Allocates the state of the mapper and sets it to its power-up values, PRG and CHR must already be loaded
+int initMapper(Cartridge *cart, const Mapper *mapper) {
+	cart->mapper = mapper;
+	cart->mapperState = NULL;
+	if (mapper->stateSize > 0) {
+		cart->mapperState = calloc(1, mapper->stateSize);
+		if (cart->mapperState == NULL)
+			return -0x01;
+	}
+	mapper->init(cart);
+	return 0;
+}
+
+void freeMapper(Cartridge *cart) {
+	free(cart->mapperState);
+	cart->mapperState = NULL;
+}
+
+// buffer must hold cart->mapper->stateSize bytes
+void saveMapperState(const Cartridge *cart, void *buffer) {
+	if (cart->mapper->stateSize > 0)
+		memcpy(buffer, cart->mapperState, cart->mapper->stateSize);
+}
+
+void loadMapperState(Cartridge *cart, const void *buffer) {
+	if (cart->mapper->stateSize > 0)
+		memcpy(cart->mapperState, buffer, cart->mapper->stateSize);
+	if (cart->mapper->sync != NULL)
+		cart->mapper->sync(cart);
+}
\ No newline at end of file
@@ -0,0 +1,62 @@
+#ifndef MAPPER_H
+#define MAPPER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "bus.h"
+
+// iNES mapper numbers
+#define MAPPER_NROM 0
+#define MAPPER_MMC1 1
+#define MAPPER_UXROM 2
+#define MAPPER_CNROM 3
+#define MAPPER_MMC3 4
+#define MAPPER_AXROM 7
+#define MAPPER_COLORDREAMS 11
+#define MAPPER_GXROM 66
+
+// What a mapper does with every access to cartridge space, resolved once when the cartridge is loaded (see initMapper) so accesses are a single indirect call
+// Each mapper keeps its registers in its own state struct (private to its file), pointed to by the cartridge
+typedef struct Mapper {
+	uint16_t id;
+	const char *name;
+	size_t stateSize; // 0 if the mapper has no state
+	bool PRGRAM; // Boards always have 8KiB of PRG RAM at 0x6000, even when the header doesn't say it is battery-backed
+
+	// Sets the state to its power-up values, once PRG and CHR are loaded
+	void (*init)(Cartridge *cart);
+
+	uint8_t (*readPRG)(Bus *bus, uint16_t address); // CPU space from 0x4020
+	void (*writePRG)(Bus *bus, uint16_t address, uint8_t data);
+	uint8_t (*readCHR)(Bus *bus, uint16_t address); // Pattern tables, as nametables are mapped with setMirroring
+	void (*writeCHR)(Bus *bus, uint16_t address, uint8_t data);
+
+	// Hooks for mappers that watch the PPU, NULL if the mapper doesn't need them
+	void (*ppuA12)(Bus *bus, uint16_t address); // Called with the addresses the PPU puts on its bus, to see A12 change
+	void (*scanline)(Bus *bus); // Called instead of ppuA12 when A12 only rises once per rendered scanline, on a dot known in advance
+
+	// Rebuilds whatever derives from the state (banks, mirroring, IRQ line...) once it was loaded, NULL if nothing does
+	// The state is saved and loaded as is (see saveMapperState), so it can't hold pointers
+	void (*sync)(Cartridge *cart);
+} Mapper;
+
+// Mappers
+extern const Mapper nromMapper;
+extern const Mapper mmc1Mapper;
+extern const Mapper mmc3Mapper;
+extern const Mapper uxromMapper;
+extern const Mapper cnromMapper;
+extern const Mapper axromMapper;
+extern const Mapper gxromMapper;
+extern const Mapper colorDreamsMapper;
+
+// Interface functions
+const Mapper *findMapper(uint16_t id);
+int initMapper(Cartridge *cart, const Mapper *mapper);
+void freeMapper(Cartridge *cart);
+void saveMapperState(const Cartridge *cart, void *buffer);
+void loadMapperState(Cartridge *cart, const void *buffer);
+
+#endif // ifndef MAPPER_H
\ No newline at end of file
@@ -0,0 +1,108 @@
+#include "mapper.h"
+
+#include "cartridge.h"
+#include "cpu.h"
+
+// Registers, selected by bits 13-14 of the address written to
+#define MMC1_REG_CTRL 0
+#define MMC1_REG_CHR1 1
+#define MMC1_REG_CHR2 2
+#define MMC1_REG_PRG 3
+#define MMC1_CTRL_MIRRORING 0b00011
+#define MMC1_CTRL_PRG16K_SELECT 0b00100
+#define MMC1_CTRL_PRG16K_ENABLE 0b01000
+#define MMC1_CTRL_CHR4K_ENABLE 0b10000
+#define MMC1_RESET_BIT 0b10000000
+#define MMC1_REG_CTRL_DEFAULTVALUE 0b01100
+#define MMC1_REG_SHIFT_DEFAULTVALUE 0b100000
+
+typedef struct MMC1State {
+	uint8_t registers[4]; // MMC1_REG_*
+	uint8_t shift; // Registers are written one bit at a time, through this one
+	uint64_t lastWrite; // CPU cycle of the last write to a register, as the mapper ignores a write on the cycle following another one
+} MMC1State;
+
+
+// Non-interface functions
+// Maps the banks selected by the registers, after any of them changed
+void syncMMC1(Cartridge *cart) {
+	const MMC1State *state = cart->mapperState;
+	const uint8_t control = state->registers[MMC1_REG_CTRL];
+	if (!(control & MMC1_CTRL_PRG16K_ENABLE)) {
+		// 32K mode
+		mapPRG(cart, 0, 4, (state->registers[MMC1_REG_PRG] & 0b1110) << 14);
+	} else if (!(control & MMC1_CTRL_PRG16K_SELECT)) {
+		// First 16K is fixed, second is switchable
+		mapPRG(cart, 0, 2, 0x0000);
+		mapPRG(cart, 2, 2, state->registers[MMC1_REG_PRG] << 14);
+	} else {
+		// First 16K is switchable, second is fixed
+		mapPRG(cart, 0, 2, state->registers[MMC1_REG_PRG] << 14);
+		mapPRG(cart, 2, 2, 0x0F << 14);
+	}
+
+	if (control & MMC1_CTRL_CHR4K_ENABLE) {
+		// 4K mode
+		mapCHR(cart, 0, 4, state->registers[MMC1_REG_CHR1] << 12);
+		mapCHR(cart, 4, 4, state->registers[MMC1_REG_CHR2] << 12);
+	} else {
+		// 8K mode
+		mapCHR(cart, 0, 8, (state->registers[MMC1_REG_CHR1] & 0b11110) << 12);
+	}
+
+	switch (control & MMC1_CTRL_MIRRORING) {
+		case 0b00: setMirroring(cart, MIRROR_1SCREENA); break;
+		case 0b01: setMirroring(cart, MIRROR_1SCREENB); break;
+		case 0b10: setMirroring(cart, MIRROR_VERTICAL); break;
+		case 0b11: setMirroring(cart, MIRROR_HORIZONTAL); break;
+	}
+}
+
+void initMMC1(Cartridge *cart) {
+	MMC1State *state = cart->mapperState;
+	state->registers[MMC1_REG_CTRL] = MMC1_REG_CTRL_DEFAULTVALUE;
+	state->shift = MMC1_REG_SHIFT_DEFAULTVALUE;
+	state->lastWrite = 0;
+	syncMMC1(cart);
+}
+
+void writePRGMMC1(Bus *bus, uint16_t address, uint8_t data) {
+	Cartridge *cart = bus->cartridge;
+	MMC1State *state = cart->mapperState;
+	if (address < 0x8000) {
+		writePRGRAM(cart, address, data);
+		return;
+	}
+
+	// Write to cartridge register
+	// Consecutives writes (the dummy write and the write of read-modify-write instructions) are ignored
+	if (bus->cpu->cycleCount <= state->lastWrite + 1)
+		return;
+	state->lastWrite = bus->cpu->cycleCount;
+
+	if (data & MMC1_RESET_BIT) {
+		// We set the register to 1 so we can detect when there has been 5 shifts (5 writes) to dump the shift register's data into one of the other 4 registers
+		state->shift = MMC1_REG_SHIFT_DEFAULTVALUE;
+		state->registers[MMC1_REG_CTRL] |= MMC1_REG_CTRL_DEFAULTVALUE; // Only these bits are set, the others are unchanged
+		syncMMC1(cart);
+		return;
+	}
+
+	state->shift >>= 1;
+	state->shift |= (data & 0b1) << 5;
+	if (state->shift & 0b1) {
+		// The initial set bit (in bit 4 of default value) is now bit 0, writing sequence completed
+		state->registers[(address >> 13) & 0b11] = state->shift >> 1;
+		state->shift = MMC1_REG_SHIFT_DEFAULTVALUE;
+		syncMMC1(cart);
+	}
+}
+
+
+// Interface functions
+const Mapper mmc1Mapper = {
+	MAPPER_MMC1, "MMC1", sizeof(MMC1State), false, initMMC1,
+	readPRGBanks, writePRGMMC1, readCHRBanks, writeCHRBanks,
+	NULL, NULL,
+	syncMMC1
+};
\ No newline at end of file
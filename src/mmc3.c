@@ -0,0 +1,161 @@
+#include "mapper.h"
+
+#include <string.h>
+
+#include "cartridge.h"
+#include "cpu.h"
+
+// Registers, selected by bits 13-14 and bit 0 of the address written to
+#define MMC3_REG_BANKSELECT 0x8000
+#define MMC3_REG_BANKDATA 0x8001
+#define MMC3_REG_MIRRORING 0xA000
+#define MMC3_REG_RAMPROTECT 0xA001
+#define MMC3_REG_IRQLATCH 0xC000
+#define MMC3_REG_IRQRELOAD 0xC001
+#define MMC3_REG_IRQDISABLE 0xE000
+#define MMC3_REG_IRQENABLE 0xE001
+#define MMC3_SELECT_BANK 0b00000111
+#define MMC3_SELECT_PRGSWAP 0b01000000 // 0x8000 is fixed to the second-last bank and the selected one moves to 0xC000
+#define MMC3_SELECT_CHRINVERT 0b10000000 // The 2KiB banks are at 0x1000 and the 1KiB ones at 0x0000
+#define MMC3_A12_FILTER 4 // CPU cycles A12 has to stay low for its next rise to clock the counter, longer than the nametable fetches between pattern fetches (3 cycles at most)
+
+typedef struct MMC3State {
+	uint8_t bankSelect;
+	uint8_t banks[8]; // R0-R1 are 2KiB CHR banks, R2-R5 1KiB CHR banks and R6-R7 8KiB PRG banks
+	uint8_t mirroring;
+	uint8_t ramProtect; // Kept but ignored, like most emulators do so MMC6 games work
+
+	uint8_t irqLatch;
+	uint8_t irqCounter;
+	bool irqReload;
+	bool irqEnabled;
+	bool irqLine; // Pending IRQ, which cart->irqOut follows, kept here so it is saved with the rest of the state
+	// The counter is clocked by rises of A12 after it stayed low long enough
+	bool a12High;
+	uint64_t a12LowSince; // CPU cycle
+} MMC3State;
+
+
+// Non-interface functions
+// Maps the banks selected by the registers and sets the IRQ line, after any of them changed
+void syncMMC3(Cartridge *cart) {
+	const MMC3State *state = cart->mapperState;
+	const uint32_t secondLast = cart->PRGsize - 0x4000;
+	if (state->bankSelect & MMC3_SELECT_PRGSWAP) {
+		mapPRG(cart, 0, 1, secondLast);
+		mapPRG(cart, 2, 1, state->banks[6] << 13);
+	} else {
+		mapPRG(cart, 0, 1, state->banks[6] << 13);
+		mapPRG(cart, 2, 1, secondLast);
+	}
+	mapPRG(cart, 1, 1, state->banks[7] << 13);
+	mapPRG(cart, 3, 1, cart->PRGsize - 0x2000);
+
+	const int invert = (state->bankSelect & MMC3_SELECT_CHRINVERT) ? 4 : 0;
+	mapCHR(cart, 0 ^ invert, 2, (state->banks[0] & 0xFE) << 10);
+	mapCHR(cart, 2 ^ invert, 2, (state->banks[1] & 0xFE) << 10);
+	for (int i = 0; i < 4; i++)
+		mapCHR(cart, (4 + i) ^ invert, 1, state->banks[2 + i] << 10);
+
+	// Four-screen boards ignore the register
+	if (cart->extraVRAM == NULL)
+		setMirroring(cart, (state->mirroring & 0b1) ? MIRROR_HORIZONTAL : MIRROR_VERTICAL);
+
+	cart->irqOut = state->irqLine;
+}
+
+void clockCounterMMC3(Cartridge *cart) {
+	MMC3State *state = cart->mapperState;
+	if (state->irqCounter == 0 || state->irqReload) {
+		state->irqCounter = state->irqLatch;
+		state->irqReload = false;
+	} else {
+		state->irqCounter--;
+	}
+
+	if (state->irqCounter == 0 && state->irqEnabled)
+		cart->irqOut = state->irqLine = true;
+}
+
+void initMMC3(Cartridge *cart) {
+	MMC3State *state = cart->mapperState;
+	memset(state, 0, sizeof(MMC3State));
+	// Boards have no mirroring solder pad, so make the register match the header until the game writes it
+	state->mirroring = (cart->mirroringType == MIRROR_HORIZONTAL);
+	syncMMC3(cart);
+}
+
+void writePRGMMC3(Bus *bus, uint16_t address, uint8_t data) {
+	Cartridge *cart = bus->cartridge;
+	MMC3State *state = cart->mapperState;
+	if (address < 0x8000) {
+		writePRGRAM(cart, address, data);
+		return;
+	}
+
+	switch (address & 0xE001) {
+		case MMC3_REG_BANKSELECT:
+			state->bankSelect = data;
+			syncMMC3(cart);
+			break;
+		case MMC3_REG_BANKDATA:
+			state->banks[state->bankSelect & MMC3_SELECT_BANK] = data;
+			syncMMC3(cart);
+			break;
+		case MMC3_REG_MIRRORING:
+			state->mirroring = data;
+			syncMMC3(cart);
+			break;
+		case MMC3_REG_RAMPROTECT:
+			state->ramProtect = data;
+			break;
+		case MMC3_REG_IRQLATCH:
+			state->irqLatch = data;
+			break;
+		case MMC3_REG_IRQRELOAD:
+			// The counter is reloaded on its next clock
+			state->irqCounter = 0;
+			state->irqReload = true;
+			break;
+		case MMC3_REG_IRQDISABLE:
+			// Also acknowledges a pending IRQ
+			state->irqEnabled = false;
+			cart->irqOut = state->irqLine = false;
+			break;
+		case MMC3_REG_IRQENABLE:
+			state->irqEnabled = true;
+			break;
+	}
+}
+
+// Every address the PPU puts on its bus, when the A12 rises can't be predicted (see scanlineMMC3)
+void ppuA12MMC3(Bus *bus, uint16_t address) {
+	MMC3State *state = bus->cartridge->mapperState;
+	const bool high = (address & 0x1000) != 0;
+	if (high && !state->a12High) {
+		// Rises after too short a low (between the pattern fetches of 8x16 sprites...) are filtered out
+		if (bus->cpu->cycleCount - state->a12LowSince >= MMC3_A12_FILTER)
+			clockCounterMMC3(bus->cartridge);
+	} else if (!high && state->a12High) {
+		state->a12LowSince = bus->cpu->cycleCount;
+	}
+	state->a12High = high;
+}
+
+// The only rise of A12 the counter sees on a rendered scanline, when the background and 8x8 sprites are on different pattern tables
+void scanlineMMC3(Bus *bus) {
+	MMC3State *state = bus->cartridge->mapperState;
+	clockCounterMMC3(bus->cartridge);
+	// A12 falls again right after, which PPUDATA accesses outside of rendering have to see
+	state->a12High = false;
+	state->a12LowSince = bus->cpu->cycleCount;
+}
+
+
+// Interface functions
+const Mapper mmc3Mapper = {
+	MAPPER_MMC3, "MMC3", sizeof(MMC3State), true, initMMC3,
+	readPRGBanks, writePRGMMC3, readCHRBanks, writeCHRBanks,
+	ppuA12MMC3, scanlineMMC3,
+	syncMMC3
+};
\ No newline at end of file
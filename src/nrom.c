@@ -0,0 +1,25 @@
+#include "mapper.h"
+#include "cartridge.h"
+
+// NROM has no registers: 16 or 32KiB of PRG at 0x8000 (mirrored if 16KiB), and 8KiB of CHR
+
+
+// Non-interface functions
+void initNROM(Cartridge *cart) {
+	mapPRG(cart, 0, 4, 0x0000);
+	mapCHR(cart, 0, 8, 0x0000);
+}
+
+void writePRGNROM(Bus *bus, uint16_t address, uint8_t data) {
+	// PRG ROM; no writes, only to PRG RAM if the cartridge has some
+	writePRGRAM(bus->cartridge, address, data);
+}
+
+
+// Interface functions
+const Mapper nromMapper = {
+	MAPPER_NROM, "NROM", 0, false, initNROM,
+	readPRGBanks, writePRGNROM, readCHRBanks, writeCHRBanks,
+	NULL, NULL,
+	NULL
+};
\ No newline at end of file
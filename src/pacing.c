@@ -0,0 +1,115 @@
+#include "pacing.h"
+
+#include <stdio.h>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <time.h>
+#include <errno.h>
+#endif
+
+
+// Non-interface functions
+// Monotonic time, in nanoseconds
+int64_t currentTime(void) {
+#ifdef _WIN32
+	LARGE_INTEGER counter, frequency;
+	QueryPerformanceCounter(&counter);
+	QueryPerformanceFrequency(&frequency);
+	return (int64_t)((double)counter.QuadPart * 1e9 / frequency.QuadPart);
+#else
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+#endif
+}
+
+// Sleeps until the given time, or returns right away if it already passed
+void sleepUntil(int64_t time) {
+#ifdef _WIN32
+	// Sleep only has a resolution of a millisecond (with timeBeginPeriod), so it is left to the spin to be precise
+	const int64_t remaining = time - currentTime();
+	if (remaining > 1000000)
+		Sleep(remaining / 1000000);
+#else
+	struct timespec wakeUp;
+	wakeUp.tv_sec = time / 1000000000;
+	wakeUp.tv_nsec = time % 1000000000;
+	// An absolute deadline doesn't drift when sleeping is interrupted (and restarted) by a signal
+	// Any other error (an invalid deadline) gives up on sleeping, and is left to the spin
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wakeUp, NULL) == EINTR);
+#endif
+}
+
+
+// Interface functions
+void initPacer(Pacer *pacer, double frameDuration) {
+	pacer->frameDuration = frameDuration * 1e9;
+	pacer->deadline = currentTime();
+	pacer->spin = PACING_MAXSPIN / 4;
+
+	pacer->frames = pacer->resyncs = 0;
+	for (int i = 0; i <= PACING_JITTERBUCKETS; i++)
+		pacer->jitterBuckets[i] = 0;
+	pacer->jitterSum = 0;
+	pacer->jitterWorst = 0;
+}
+
+// Returns at the start of the next frame
+void waitNextFrame(Pacer *pacer) {
+	int64_t now = currentTime();
+	if (now - pacer->deadline > PACING_MAXLAG * pacer->frameDuration) {
+		pacer->deadline = now;
+		pacer->resyncs++;
+	}
+
+	const int64_t wakeUp = pacer->deadline - pacer->spin;
+	if (now < wakeUp) {
+		sleepUntil(wakeUp);
+		now = currentTime();
+
+		// Adapts the spin to how late sleeping woke up
+		const int64_t oversleep = now - wakeUp;
+		if (oversleep + PACING_SPINPADDING > pacer->spin)
+			pacer->spin = oversleep + PACING_SPINPADDING;
+		else
+			pacer->spin -= pacer->spin / PACING_SPINDECAY;
+		if (pacer->spin < PACING_MINSPIN)
+			pacer->spin = PACING_MINSPIN;
+		else if (pacer->spin > PACING_MAXSPIN)
+			pacer->spin = PACING_MAXSPIN;
+	}
+	while (now < pacer->deadline)
+		now = currentTime();
+
+	const int64_t jitter = now - pacer->deadline;
+	pacer->frames++;
+	pacer->jitterSum += jitter;
+	const int bounds[PACING_JITTERBUCKETS] = PACING_JITTERBOUNDS;
+	int bucket = 0;
+	while (bucket < PACING_JITTERBUCKETS && jitter >= bounds[bucket] * 1000)
+		bucket++;
+	pacer->jitterBuckets[bucket]++;
+	if (jitter > pacer->jitterWorst)
+		pacer->jitterWorst = jitter;
+
+	pacer->deadline += pacer->frameDuration;
+}
+
+void printPacer(const Pacer *pacer) {
+	if (pacer->frames == 0)
+		return;
+
+	printf("Frame start jitter : %u frames, %.1f us on average, %.1f us at worst, %u resyncs, final spin of %.1f us\n",
+		pacer->frames, pacer->jitterSum / pacer->frames / 1000, pacer->jitterWorst / 1000.0, pacer->resyncs, pacer->spin / 1000.0);
+	const int bounds[PACING_JITTERBUCKETS] = PACING_JITTERBOUNDS;
+	for (int i = 0; i <= PACING_JITTERBUCKETS; i++) {
+		if (pacer->jitterBuckets[i] == 0)
+			continue;
+		if (i == PACING_JITTERBUCKETS)
+			printf("\t>= %4i us : %7u (%5.1f%%)\n", bounds[i - 1], pacer->jitterBuckets[i], 100.0 * pacer->jitterBuckets[i] / pacer->frames);
+		else
+			printf("\t<  %4i us : %7u (%5.1f%%)\n", bounds[i], pacer->jitterBuckets[i], 100.0 * pacer->jitterBuckets[i] / pacer->frames);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,39 @@
+#ifndef PACING_H
+#define PACING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// The pacer sleeps until spin nanoseconds before each deadline, then spins for the rest, as sleeping alone usually wakes up late by tens or hundreds of microseconds
+// The spin is adapted to how late sleeping actually wakes up: it grows right away to the latest oversleep plus PACING_SPINPADDING, and shrinks slowly otherwise, staying between PACING_MINSPIN and PACING_MAXSPIN
+#define PACING_MINSPIN 50000 // In nanoseconds
+#define PACING_MAXSPIN 2000000
+#define PACING_SPINPADDING 50000 // Spin left on top of the latest oversleep
+#define PACING_SPINDECAY 64 // The spin shrinks by 1/PACING_SPINDECAY every frame it wasn't needed
+
+// After falling behind by more than this many frames (e.g. while the window is being dragged), deadlines start over from now rather than rushing to catch up
+#define PACING_MAXLAG 3
+
+// Jitter is counted in buckets bounded by these (in microseconds), the last bucket taking everything later
+#define PACING_JITTERBUCKETS 8
+#define PACING_JITTERBOUNDS {5, 10, 20, 50, 100, 200, 500, 1000}
+
+typedef struct Pacer {
+	int64_t frameDuration; // In nanoseconds, as are all times
+	int64_t deadline; // Start of the next frame
+	int64_t spin; // How long before the deadline sleeping stops
+
+	// Jitter is how late a frame started compared to its deadline
+	uint32_t frames;
+	uint32_t resyncs; // Deadlines dropped after falling too far behind
+	uint32_t jitterBuckets[PACING_JITTERBUCKETS + 1];
+	double jitterSum;
+	int64_t jitterWorst;
+} Pacer;
+
+// Interface functions
+void initPacer(Pacer *pacer, double frameDuration);
+void waitNextFrame(Pacer *pacer);
+void printPacer(const Pacer *pacer);
+
+#endif // ifndef PACING_H
\ No newline at end of file
@@ -0,0 +1,104 @@
+#include "audio.h"
+
+#include <string.h>
+
+#include "Portaudio/portaudio.h"
+
+
+// Non-interface functions
+void printPortaudioError(PaError error, const char *file, int line) {
+	printf("Portaudio error from file %s:%i : %s\n", file, line, Pa_GetErrorText(error));
+}
+
+// Fills a whole block of samples from the ring
+int portaudioCallback(const void *input, void *output, unsigned long framesPerBuffer, const PaStreamCallbackTimeInfo *timeInfo, PaStreamCallbackFlags status, void *userData) {
+	AudioRing *ring = (AudioRing *)userData;
+	float *out = (float *)output;
+
+	const uint32_t read = ring->readIndex;
+	const uint32_t available = ringAvailable(&ring->writeIndex, read);
+	const uint32_t count = available < framesPerBuffer ? available : framesPerBuffer;
+
+	for (uint32_t i = 0; i < count; i++)
+		out[i] = ring->buffer[(read + i) & AUDIO_RING_MASK];
+	if (count > 0)
+		ring->lastSample = out[count - 1];
+	for (uint32_t i = count; i < framesPerBuffer; i++)
+		out[i] = ring->lastSample;
+	ring->underruns += framesPerBuffer - count;
+
+	publishRing(&ring->readIndex, read + count);
+	return paContinue;
+}
+
+// PortAudio is only initialized when this sink is opened, so running without it doesn't depend on an audio device
+int openPortaudio(AudioEngine *engine, const char *path) {
+	AudioRing *ring = &engine->ring;
+	for (uint32_t i = 0; i < AUDIO_RING_SIZE; i++) {
+		ring->buffer[i] = 0.0f;
+	}
+	ring->writeIndex = ring->readIndex = 0;
+	ring->overruns = ring->underruns = 0;
+	ring->lastSample = 0.0f;
+	engine->stream = NULL;
+
+	PaError error = Pa_Initialize();
+	if (error != paNoError) {
+		printPortaudioError(error, __FILE__, __LINE__);
+		return -0x01;
+	}
+
+	error = Pa_OpenDefaultStream(&engine->stream, 0, 1, paFloat32, TARGET_SAMPLE_RATE, AUDIO_BLOCK_FRAMES, portaudioCallback, ring);
+	if (error != paNoError) {
+		printPortaudioError(error, __FILE__, __LINE__);
+		Pa_Terminate();
+		return -0x02;
+	}
+	return 0;
+}
+
+void closePortaudio(AudioEngine *engine) {
+	PaError error = Pa_CloseStream(engine->stream);
+	if (error != paNoError)
+		printPortaudioError(error, __FILE__, __LINE__);
+	error = Pa_Terminate();
+	if (error != paNoError)
+		printPortaudioError(error, __FILE__, __LINE__);
+}
+
+void startPortaudio(AudioEngine *engine) {
+	PaError error = Pa_StartStream(engine->stream);
+	if (error != paNoError)
+		printPortaudioError(error, __FILE__, __LINE__);
+}
+
+void stopPortaudio(AudioEngine *engine) {
+	PaError error = Pa_StopStream(engine->stream);
+	if (error != paNoError)
+		printPortaudioError(error, __FILE__, __LINE__);
+}
+
+// Samples are copied into the ring, in two parts when they wrap around its end, and whatever doesn't fit is dropped
+int32_t writePortaudio(AudioEngine *engine, const float *samples, uint32_t count) {
+	AudioRing *ring = &engine->ring;
+	const uint32_t write = ring->writeIndex;
+	const uint32_t fill = ringFill(write, &ring->readIndex);
+
+	if (count > AUDIO_RING_SIZE - fill) {
+		ring->overruns += count - (AUDIO_RING_SIZE - fill);
+		count = AUDIO_RING_SIZE - fill;
+	}
+	const uint32_t first = AUDIO_RING_SIZE - (write & AUDIO_RING_MASK);
+	memcpy(&ring->buffer[write & AUDIO_RING_MASK], samples, (count < first ? count : first) * sizeof(float));
+	if (count > first)
+		memcpy(ring->buffer, &samples[first], (count - first) * sizeof(float));
+	publishRing(&ring->writeIndex, write + count);
+	return fill;
+}
+
+// Prints how often the ring ran dry or full
+void printPortaudio(const AudioEngine *engine) {
+	printf("PortAudio : %llu samples made up on underruns, %llu dropped on overruns\n", (unsigned long long)engine->ring.underruns, (unsigned long long)engine->ring.overruns);
+}
+
+const AudioSink portaudioSink = {"portaudio", true, openPortaudio, closePortaudio, startPortaudio, stopPortaudio, writePortaudio, printPortaudio};
\ No newline at end of file
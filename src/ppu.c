@@ -1,4 +1,15 @@
 #include "ppu.h"
+#include "compose.h"
+#include "raster.h"
+#include "cartridge.h"
+
+#include <string.h>
+#include <pthread.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define PPU_SSE2
+#include <emmintrin.h>
+#endif
 
 // Undefined later
 #define PUTADDRBUS(ppu, address) ppu->addressBusLatch = address
@@ -12,13 +23,71 @@
 							? ((ppu->sprPatternIndex & 0b10000) << 8) | (ppu->sprPatternIndex & (VRAM_XNAMETABLE | VRAM_YNAMETABLE | VRAM_COARSEY)) | ((ppu->sprPatternIndex & 0b1000) << 1) \
 							: ((ppu->sprPatternIndex & 0b111111110000) | ((ppu->registers[PPUCTRL] & CTRL_SPRPATTERN) << 9))) | (ppu->sprPatternIndex & 0b111))
 
+// Scanline classes, each with its own dot actions
+#define LINECLASS_FIRST 0 // Visible scanline 0
+#define LINECLASS_VISIBLE 1 // Visible scanlines 1-239
+#define LINECLASS_POSTRENDER 2 // Scanline 240
+#define LINECLASS_VBLANKSTART 3 // Scanline 241
+#define LINECLASS_VBLANK 4 // Scanlines 242-260
+#define LINECLASS_PRERENDER 5 // Scanline 261
+#define LINECLASS_COUNT 6
+
+// Dot actions: an opcode selecting what tickPPU does on a dot, along with flags for what happens on only a few of them (see buildDotTables)
+#define DOT_OPCODE 0x00FF
+#define DOT_IDLE 0
+#define DOT_START 1
+#define DOT_STARTRENDER 2
+#define DOT_PRESTART 3
+#define DOT_PRESTARTRENDER 4
+#define DOT_BG(step) (5 + (step))
+#define DOT_BGLAST 13
+#define DOT_BGOFF 14
+#define DOT_BGLASTOFF 15
+#define DOT_PREBG(step) (16 + (step))
+#define DOT_PREBGLAST 24
+#define DOT_SHIFT 25
+#define DOT_SPR(step) (26 + (step))
+#define DOT_SPROFF 34
+#define DOT_NEXT(step) (35 + (step))
+#define DOT_NEXTOFF 43
+#define DOT_GARBAGEADDR 44
+#define DOT_GARBAGEREAD 45
+#define DOT_GARBAGEOFF 46
+#define DOT_FRAMEDONE 47
+#define DOT_VBLANK 48
+#define DOT_FLAGS 0xFF00
+#define DOT_INCX 0x0100
+#define DOT_COPYX 0x0200
+#define DOT_COPYY 0x0400
+#define DOT_FEED 0x0800
+#define DOT_CLEARSTATUS 0x1000
+#define DOT_ODDSKIP 0x2000 // Dot 340 of the pre-render scanline is skipped on odd frames
+#define DOT_A12RISE 0x4000 // A12 rises for the only time the mapper can see on this scanline, which it is told without looking at addresses
+#define DOT_WATCHA12 0x8000 // The address put on the bus on the previous dot is handed to the mapper
+
+// How mappers watching A12 are told about it, which depends on where the pattern tables are
+// With 8x8 sprites and the background and sprites on different pattern tables, A12 rises once per rendered scanline on a known dot, and every other rise is too short for the mapper to see
+// Anything else needs every address to be watched
+#define A12_NONE 0 // The mapper doesn't watch A12
+#define A12_SPRITES 1 // Sprites at 0x1000 and background at 0x0000: rises on the first sprite pattern fetch (dot 261)
+#define A12_BACKGROUND 2 // Background at 0x1000 and sprites at 0x0000: rises on the first pattern fetch for the next scanline (dot 325), and on the pre-render scanline also on its first pattern fetch (dot 5), as A12 stayed low through VBlank
+#define A12_WATCH 3 // 8x16 sprites, or the background and sprites on the same pattern table
+#define A12_MODES 4
+
+// Undefined later
+// Sprite evaluation on dots 1-255, unless deferred to dot 256
+#define EVALUATE(ppu, pix) if (!ppu->sprEvalDeferred) evaluateSpriteDot(ppu, pix)
+
+// Shared by every PPU and only ever read once built, which happens once per process (see initPPU)
+static uint16_t dotTables[LINECLASS_COUNT][2][A12_MODES][341];
+static pthread_once_t dotTablesBuilt = PTHREAD_ONCE_INIT;
+
 
 // Non-interface functions
 void shiftRegistersPPU(PPU *ppu) {
-	// These internal registers use the most significant bit to render next
-	ppu->bgPatternData[0] <<= 1;
+	// These internal registers use the most significant bits to render next
+	ppu->bgPatternData <<= 2;
 	ppu->bgPaletteData[0] <<= 1;
-	ppu->bgPatternData[1] <<= 1;
 	ppu->bgPaletteData[1] <<= 1;
 	ppu->bgPaletteData[0] |= ppu->bgSerialPaletteLatch[0];
 	ppu->bgPaletteData[1] |= ppu->bgSerialPaletteLatch[1];
@@ -43,8 +112,7 @@ void incrementY(PPU *ppu) {
 }
 
 void feedShiftRegisters(PPU *ppu) {
-	ppu->bgPatternData[0] |= ppu->bgPatternLatch[0];
-	ppu->bgPatternData[1] |= ppu->bgPatternLatch[1];
+	ppu->bgPatternData |= ppu->bgPatternLatch;
 	// Unlike pattern data, bgPaletteLatch uses its least significant bits to render next
 	ppu->bgSerialPaletteLatch[0] = ppu->bgPaletteLatch & 0b1;
 	ppu->bgSerialPaletteLatch[1] = ppu->bgPaletteLatch & 0b10;
@@ -57,21 +125,19 @@ void renderPixel(PPU *ppu) {
 	uint16_t pix = ppu->pixel;
 	for (int i = 7; i >= 0; i--) {
 		const uint8_t xPos = ppu->sprXPos[i];
-		const uint8_t shiftValue = (pix - xPos);
-		// Checks if (x pos in range of current scanline) AND (selected color bit is non-zero)
-		if ((pix >= xPos && pix < xPos + 8) && (((ppu->sprPatternLow[i] | ppu->sprPatternHigh[i]) << shiftValue) & 0x80)) {
+		if (pix >= xPos && pix < xPos + 8) {
 			// Similar to background data, most significant bits of sprite data are the next to be rendered
-			sprColor = ((ppu->sprPatternLow[i] << shiftValue) & 0x80) >> 7;
-			sprColor |= ((ppu->sprPatternHigh[i] << shiftValue) & 0x80) >> 6;
-
-			attributes = ppu->sprAttributes[i];
-			outputUnit = i;
+			const uint8_t color = ((ppu->sprPattern[i] << ((pix - xPos) << 1)) >> 14) & 0b11;
+			if (color) {
+				sprColor = color;
+				attributes = ppu->sprAttributes[i];
+				outputUnit = i;
+			}
 		}
 	}
 
-	// Most significant bits of bgPatternData (0x8000; bit 15) and bgPaletteData (0x80; bit 7) are the next one to be rendered
-	bgColor = ((ppu->bgPatternData[0] << ppu->fineX) & 0x8000) >> 15;
-	bgColor |= ((ppu->bgPatternData[1] << ppu->fineX) & 0x8000) >> 14;
+	// Most significant bits of bgPatternData (bits 30-31) and bgPaletteData (0x80; bit 7) are the next one to be rendered
+	bgColor = (ppu->bgPatternData << (ppu->fineX << 1)) >> 30;
 
 	// Disables rendering according to PPUMASK
 	if (!(ppu->registers[PPUMASK] & MASK_RENDERSPR) || (!(ppu->registers[PPUMASK] & MASK_SHOWLEFTSPR) && pix < 8))
@@ -105,52 +171,504 @@ void renderPixel(PPU *ppu) {
 		paletteIndex = (ppu->addressVRAM - 0x3F00) & 0b1111;
 	}
 
-	// Render with greyscale accprding to PPUMASK
-	int framebufferIndex = (ppu->scanline * 256 + pix) * 3;
-	ppu->framebuffer[framebufferIndex] = ppu->colors[ppu->palettes[paletteIndex] & (ppu->registers[PPUMASK] & 0b1 ? 0x30 : 0x3F)][0];
-	ppu->framebuffer[framebufferIndex + 1] = ppu->colors[ppu->palettes[paletteIndex] & (ppu->registers[PPUMASK] & 0b1 ? 0x30 : 0x3F)][1];
-	ppu->framebuffer[framebufferIndex + 2] = ppu->colors[ppu->palettes[paletteIndex] & (ppu->registers[PPUMASK] & 0b1 ? 0x30 : 0x3F)][2];
+	// Render with greyscale and emphasis according to PPUMASK
+	// Pixel 256 is off-screen (it used to overwrite the first pixel of the next scanline, or to overflow the framebuffer on the last one)
+	if (pix < 256)
+		ppu->framebuffer[ppu->scanline * 256 + pix] = PIXEL(ppu->palettes[paletteIndex] & (ppu->registers[PPUMASK] & 0b1 ? 0x30 : 0x3F), ppu->registers[PPUMASK]);
+}
+
+// Composes the pixels logged so far on the current scanline, which then won't be left to the rasterizer
+void flushScanlineLog(PPU *ppu) {
+	const ScanlineLog *log = &ppu->rasterizer->lines[ppu->scanline];
+	for (uint16_t pix = 0; pix < ppu->pixel; pix += 16) {
+		ppu->pendingPixel = pix;
+		ppu->pendingCount = (ppu->pixel - pix < 16) ? ppu->pixel - pix : 16;
+		memcpy(ppu->pendingBg, &log->bg[pix], ppu->pendingCount);
+		memcpy(ppu->pendingMask, &log->mask[pix], ppu->pendingCount);
+		ppu->composePixels(ppu);
+	}
+	ppu->loggingLine = false;
+}
+
+void outputPixel(PPU *ppu) {
+	if (!RENDERING(ppu)) {
+		// Without rendering, neither sprites nor background are shown, so there can't be a sprite 0 hit
+		if (ppu->skipRendering)
+			return;
+
+		// Palettes may be written from now on, so this scanline can't be left to the rasterizer
+		if (ppu->loggingLine)
+			flushScanlineLog(ppu);
+
+		// The background palette hack depends on the current VRAM address, and palettes may be written while not rendering, so this pixel can't wait
+		if (ppu->pendingCount)
+			ppu->composePixels(ppu);
+		renderPixel(ppu);
+		return;
+	}
+
+	// Once sprite 0 can't hit anymore on this scanline, nothing left to do
+	if (ppu->skipRendering && (!ppu->sprZeroOnCurrent || (ppu->registers[PPUSTATUS] & STATUS_SPR0)))
+		return;
+
+	const uint16_t pix = ppu->pixel;
+	const uint8_t mask = ppu->registers[PPUMASK];
+
+	// Background palette index, taken from the most significant bits of the shift registers
+	uint8_t bg = (ppu->bgPatternData << (ppu->fineX << 1)) >> 30;
+	bg |= ((ppu->bgPaletteData[0] << ppu->fineX) & 0x80) >> 5;
+	bg |= ((ppu->bgPaletteData[1] << ppu->fineX) & 0x80) >> 4;
+
+	// Sprite 0 hits are visible to the CPU, so they are still checked on every pixel
+	if (ppu->sprZeroOnCurrent && (ppu->sprLine[pix] & SPRLINE_ZERO) && (bg & 0b11) && pix != 255
+		&& (mask & MASK_RENDERSPR) && (mask & MASK_RENDERBG) && (pix >= 8 || ((mask & MASK_SHOWLEFTSPR) && (mask & MASK_SHOWLEFTBG))))
+		ppu->registers[PPUSTATUS] |= STATUS_SPR0;
+
+	if (ppu->skipRendering)
+		return;
+
+	if (ppu->loggingLine) {
+		ScanlineLog *log = &ppu->rasterizer->lines[ppu->scanline];
+		if (pix == 256) {
+			// Neither the sprite line nor the palettes can have changed during the scanline
+			memcpy(log->sprLine, ppu->sprLine, SPRLINE_SIZE);
+			memcpy(log->palettes, ppu->palettes, 32);
+			log->deferred = true;
+			ppu->loggingLine = false;
+		} else {
+			log->bg[pix] = bg;
+			log->mask[pix] = mask;
+		}
+		return;
+	}
+
+	// Pixel 256 is the last one output on a scanline, but is off-screen
+	if (pix == 256) {
+		if (ppu->pendingCount)
+			ppu->composePixels(ppu);
+		return;
+	}
+
+	if (ppu->pendingCount == 0)
+		ppu->pendingPixel = pix;
+	ppu->pendingBg[ppu->pendingCount] = bg;
+	ppu->pendingMask[ppu->pendingCount] = mask;
+	ppu->pendingCount++;
+
+	if (ppu->pendingCount == 16)
+		ppu->composePixels(ppu);
+}
+
+// Hashes the 256 pixels of a scanline 8 bytes at a time, in 4 independent lanes so the multiplications can overlap
+uint64_t hashScanline(const uint16_t *line) {
+	uint64_t lanes[4] = {1, 2, 3, 4};
+	for (int i = 0; i < 256; i += 16) {
+		for (int j = 0; j < 4; j++) {
+			uint64_t word;
+			memcpy(&word, &line[i + j * 4], sizeof(uint64_t));
+			lanes[j] = (lanes[j] ^ word) * 0x9E3779B97F4A7C15;
+			lanes[j] ^= lanes[j] >> 32;
+		}
+	}
+	return (lanes[0] + lanes[1] * 3) ^ (lanes[2] * 5 + lanes[3] * 7);
+}
+
+
+// One dot (1-256) of the sprite evaluation state machine, for the next scanline
+void evaluateSpriteDot(PPU *ppu, uint16_t pix) {
+	if (pix <= 64) {
+		// Cycles 1-64 : fills the secondary OAM with 0xFF
+		if (pix & 1) {
+			// ppu->OAM[ppu->registers[OAMADDR]]; // Dummy read for future logging
+			ppu->registers[OAMDATA] = 0xFF;
+		} else {
+			ppu->secondOAM[(pix - 1) >> 1] = ppu->registers[OAMDATA];
+		}
+	} else if ((ppu->registers[OAMADDR] == 0 && pix > 66) || ((ppu->registers[OAMADDR] & 0b11111100) == 0 && ppu->sprCount >= 8)) {
+		// There are no more sprites to be evaluated
+		// The above if statement is to ensure this is reached if we reached the end of OAM without filling up secondOAM (in which case OAMADDR will always be 0) OR if we did fill it (in which case the sprite overflow bug occured, so OAMADDR will be anywhere between 0 and 3)
+		if (pix & 1) {
+			ppu->registers[OAMDATA] = ppu->OAM[ppu->registers[OAMADDR]];
+			ppu->registers[OAMADDR] &= 0b11111100;
+			// TODO fix this
+			// ppu->registers[OAMADDR] += 4;
+		} // else
+			// ppu->secondOAM[ppu->secondOAMptr]; // TODO Dummy read for future logging
+	} else {
+		// There are still sprites to be evaluated
+		// TODO maybe join spriteInRange and else together
+		if (pix & 1) ppu->registers[OAMDATA] = ppu->OAM[ppu->registers[OAMADDR]];
+		else if (ppu->spriteInRange) {
+			if (ppu->sprCount < 8)
+				ppu->secondOAM[ppu->secondOAMptr] = ppu->registers[OAMDATA];
+			// else ppu->secondOAM[ppu->secondOAMptr]; // Dummy read for future logging
+
+			ppu->registers[OAMADDR]++;
+			ppu->secondOAMptr++;
+
+			// The last byte of entry was copied
+			if ((ppu->secondOAMptr & 0b11) == 0) {
+				ppu->spriteInRange = false;
+				ppu->sprCount++;
+
+				// OAMADDR is not aligned and must be updated accordignly
+				if ((ppu->registers[OAMADDR] & 0b11) != 0)
+					ppu->registers[OAMADDR] &= 0b11111100;
+			}
+		} else {
+			if (ppu->sprCount < 8)
+				ppu->secondOAM[ppu->secondOAMptr] = ppu->registers[OAMDATA];
+			// else ppu->secondOAM[ppu->secondOAMptr]; // TODO Dummy read for future logging
+
+			// Current sprite's Y position is in range for the next scanline
+			if (ppu->scanline >= ppu->registers[OAMDATA] && ppu->scanline < ppu->registers[OAMDATA] + (ppu->registers[PPUCTRL] & CTRL_SPRSIZE ? 16 : 8)) {
+				ppu->spriteInRange = true;
+				ppu->secondOAMptr++;
+				ppu->registers[OAMADDR]++;
+
+				// Sprite zero is the first sprite read, not necessarily the one at OAM[0]
+				if (pix == 66) ppu->sprZeroOnNext = true;
+
+				// Sprite overflow occured
+				if (ppu->sprCount >= 8) ppu->registers[PPUSTATUS] |= STATUS_OFLOW;
+			} else {
+				ppu->registers[OAMADDR] += 4;
+
+				// Sprite overflow bug : both the attribute and the current sprite are incremented, without carry
+				if (ppu->sprCount >= 8 && (ppu->registers[OAMADDR] & 0b11) != 0b11)
+					ppu->registers[OAMADDR]++;
+				else
+					ppu->registers[OAMADDR] &= 0b11111100;
+			}
+		}
+	}
+}
+
+// Bit n is set if sprite n of OAM is in range for the next scanline, as tested by sprite evaluation
+uint64_t spritesInRange(PPU *ppu) {
+	const uint8_t height = ppu->registers[PPUCTRL] & CTRL_SPRSIZE ? 16 : 8;
+	uint64_t inRange = 0;
+
+#ifdef PPU_SSE2
+	// In range if y <= scanline and scanline - y < height, with unsigned saturated arithmetic (so the difference never wraps around)
+	const __m128i scanline = _mm_set1_epi8(ppu->scanline);
+	for (int i = 0; i < 4; i++) {
+		const __m128i y = _mm_loadu_si128((const __m128i *)&ppu->OAM[i << 6]);
+		const __m128i y2 = _mm_loadu_si128((const __m128i *)&ppu->OAM[(i << 6) + 16]);
+		const __m128i y3 = _mm_loadu_si128((const __m128i *)&ppu->OAM[(i << 6) + 32]);
+		const __m128i y4 = _mm_loadu_si128((const __m128i *)&ppu->OAM[(i << 6) + 48]);
+		#define INRANGE(y) _mm_and_si128(_mm_cmpeq_epi8(_mm_max_epu8((y), scanline), scanline), _mm_cmpeq_epi8(_mm_subs_epu8(_mm_subs_epu8(scanline, (y)), _mm_set1_epi8(height - 1)), _mm_setzero_si128()))
+		// Only Y positions (every 4th byte) are kept, then packed to one byte per sprite
+		#define YBYTE(v) _mm_srai_epi32(_mm_slli_epi32((v), 24), 24)
+		const __m128i packed = _mm_packs_epi16(
+			_mm_packs_epi32(YBYTE(INRANGE(y)), YBYTE(INRANGE(y2))),
+			_mm_packs_epi32(YBYTE(INRANGE(y3)), YBYTE(INRANGE(y4))));
+		#undef INRANGE
+		#undef YBYTE
+		inRange |= (uint64_t)_mm_movemask_epi8(packed) << (i << 4);
+	}
+#else
+	for (int i = 0; i < 64; i++) {
+		const uint8_t y = ppu->OAM[i << 2];
+		if (ppu->scanline >= y && ppu->scanline < y + height)
+			inRange |= (uint64_t)1 << i;
+	}
+#endif
+
+	return inRange;
+}
+
+// Whole sprite evaluation (dots 1-256) at once, when nothing could observe it in the meantime
+// The result is the same as evaluateSpriteDot() for each dot: sprites that aren't in range are skipped in bulk, everything else goes through the state machine
+void evaluateSpritesBatched(PPU *ppu) {
+	// Cycles 1-64 : fills the secondary OAM with 0xFF
+	for (int i = 0; i < 32; i++)
+		ppu->secondOAM[i] = 0xFF;
+	ppu->registers[OAMDATA] = 0xFF;
+
+	const uint64_t inRange = spritesInRange(ppu);
+	uint16_t pix = 65;
+	while (pix <= 256) {
+		const uint8_t address = ppu->registers[OAMADDR];
+
+		// Sprites out of range each take 2 dots, and only leave traces of the last one read
+		if (!ppu->spriteInRange && ppu->sprCount < 8 && (address & 0b11) == 0 && (address != 0 || pix == 65)) {
+			const uint64_t next = inRange >> (address >> 2);
+			int skipped = next ? __builtin_ctzll(next) : 64 - (address >> 2);
+			if (skipped > (257 - pix) >> 1)
+				skipped = (257 - pix) >> 1;
+
+			if (skipped) {
+				ppu->registers[OAMDATA] = ppu->OAM[(uint8_t)(address + ((skipped - 1) << 2))];
+				ppu->secondOAM[ppu->secondOAMptr] = ppu->registers[OAMDATA];
+				ppu->registers[OAMADDR] += skipped << 2;
+				pix += skipped << 1;
+				continue;
+			}
+		}
+
+		// Once there are no more sprites to be evaluated, OAMADDR is aligned on the first odd dot, then the remaining ones all do the same
+		if ((address == 0 && pix > 66) || ((address & 0b11111100) == 0 && ppu->sprCount >= 8)) {
+			evaluateSpriteDot(ppu, pix);
+			if (pix < 255)
+				evaluateSpriteDot(ppu, pix + 2);
+			break;
+		}
+
+		evaluateSpriteDot(ppu, pix);
+		evaluateSpriteDot(ppu, pix + 1);
+		pix += 2;
+	}
+}
+
+// Catches up with sprite evaluation if it was deferred, before something observes or alters it
+void syncSpriteEvaluation(PPU *ppu) {
+	if (!ppu->sprEvalDeferred)
+		return;
+
+	// Rendering can't have changed since the beginning of the scanline, as PPUMASK writes sync first
+	ppu->sprEvalDeferred = false;
+	if (RENDERING(ppu) && ppu->scanline != 261)
+		for (uint16_t pix = 1; pix < ppu->pixel && pix <= 256; pix++)
+			evaluateSpriteDot(ppu, pix);
+}
+
+// Background fetches, one step of 8 for each tile (used with a constant step, so the switch folds away)
+static inline void fetchBackground(PPU *ppu, uint8_t step) {
+	switch (step) {
+		case 0b000: PUTADDRBUS(ppu, NAMETABLEADDR(ppu)); break;
+		case 0b001: ppu->bgNametableLatch = ppuRead(ppu->bus, NAMETABLEADDR(ppu)); break;
+		case 0b010: PUTADDRBUS(ppu, ATTRIBUTEADDR(ppu)); break;
+		case 0b011: ppu->bgPaletteLatch = ppuRead(ppu->bus, ATTRIBUTEADDR(ppu)); ppu->bgPaletteLatch >>= ((ppu->addressVRAM & 0b1000000) >> 4) | (ppu->addressVRAM & 0b10); break;
+		case 0b100: PUTADDRBUS(ppu, BGPATTERNADDR(ppu)); break;
+		case 0b101: break; // Low plane is fetched along with the high plane from the tile cache
+		case 0b110: PUTADDRBUS(ppu, 0b1000 | BGPATTERNADDR(ppu)); break;
+		case 0b111: ppu->bgPatternLatch = ppuReadTileRow(ppu->bus, BGPATTERNADDR(ppu), false); break;
+	}
+}
+
+// Sprite fetches for the next scanline (dots 257-320), one step of 8 for each sprite
+static inline void fetchSprite(PPU *ppu, uint16_t pix, uint8_t step) {
+	const uint8_t currentOAM = ((pix - 1) & 0b11) | (((pix - 1) >> 1) & 0b11100);
+	const uint8_t currentSprite = ((pix - 1) >> 3) & 0b111;
+	switch (step) {
+		case 0b000:
+			// Sprite Y position
+			ppu->registers[OAMDATA] = ppu->secondOAM[currentOAM];
+			ppu->sprPatternIndex = ppu->scanline - ppu->registers[OAMDATA];
+
+			// Garbage nametable
+			PUTADDRBUS(ppu, NAMETABLEADDR(ppu));
+			break;
+		case 0b001:
+			// Sprite index
+			ppu->registers[OAMDATA] = ppu->secondOAM[currentOAM];
+			ppu->sprPatternIndex |= ppu->registers[OAMDATA] << 4;
+
+			// Garbage nametable
+			ppuRead(ppu->bus, NAMETABLEADDR(ppu));
+			break;
+		case 0b010:
+			// Sprite attributes
+			ppu->registers[OAMDATA] = ppu->secondOAM[currentOAM];
+			ppu->sprAttributes[currentSprite] = ppu->registers[OAMDATA];
+			if (ppu->registers[OAMDATA] & SPR_VERTSYMMETRY) {
+				// TODO maybe add macros for those pattern bitmaps ?
+				// Individual tile is flipped, whether in 8x8 or 8x16 mode
+				ppu->sprPatternIndex = (ppu->sprPatternIndex & 0b111111111000) | (7 - (ppu->sprPatternIndex & 0b111)); // Vertical symmetry, if applicable
+				if (ppu->registers[PPUCTRL] & CTRL_SPRSIZE) {
+					// In 8x16 mode, the top and bottom halves are switched in addition to each being flipped individually
+					ppu->sprPatternIndex ^= 0b1000; // Switch the bit selecting top or bottom half of 8x16 sprite
+				}
+			}
+
+			// Garbage attribute table
+			PUTADDRBUS(ppu, ATTRIBUTEADDR(ppu));
+			break;
+		case 0b011:
+			// Sprite X position
+			ppu->registers[OAMDATA] = ppu->secondOAM[currentOAM];
+			ppu->sprXPos[currentSprite] = ppu->registers[OAMDATA];
+
+			// Garbage attribute table
+			ppuRead(ppu->bus, ATTRIBUTEADDR(ppu));
+			break;
+		case 0b100:
+			// Garbage OAM read
+			ppu->registers[OAMDATA] = ppu->secondOAM[currentOAM | 0b11];
+
+			// Sprite pattern fetch
+			PUTADDRBUS(ppu, SPRPATTERNADDR(ppu));
+			break;
+		case 0b101:
+			// Garbage OAM read
+			ppu->registers[OAMDATA] = ppu->secondOAM[currentOAM | 0b11];
+
+			// Sprite pattern fetch: low plane is fetched along with the high plane from the tile cache
+			break;
+		case 0b110:
+			// Garbage OAM read and sprite high pattern fetch
+			ppu->registers[OAMDATA] = ppu->secondOAM[currentOAM | 0b11];
+			PUTADDRBUS(ppu, 0b1000 | SPRPATTERNADDR(ppu));
+			break;
+		case 0b111:
+			// Garbage OAM read and sprite high pattern fetch
+			ppu->registers[OAMDATA] = ppu->secondOAM[currentOAM | 0b11];
+			if (currentSprite >= ppu->sprCount)
+				ppu->sprPattern[currentSprite] = 0x0000;
+			else
+				ppu->sprPattern[currentSprite] = ppuReadTileRow(ppu->bus, SPRPATTERNADDR(ppu), ppu->sprAttributes[currentSprite] & SPR_HORSYMMETRY); // Mirrored copy for horizontal symmetry, if applicable
+			break;
+	}
 }
 
-uint8_t flipByte(uint8_t value) {
-	uint8_t result = 0;
-	for (int i = 0; i < 8; i++)
-		result |= (value & (1 << i)) >> i << (7 - i);
+// Builds the action of every dot, for each scanline class, with and without rendering
+void buildDotTables(void) {
+	for (int lineClass = 0; lineClass < LINECLASS_COUNT; lineClass++) {
+		for (int rendering = 0; rendering < 2; rendering++) {
+			uint16_t *actions = dotTables[lineClass][rendering][A12_NONE];
+			for (int pix = 0; pix < 341; pix++)
+				actions[pix] = DOT_IDLE;
+
+			if (lineClass == LINECLASS_POSTRENDER) {
+				actions[0] = DOT_FRAMEDONE;
+				continue;
+			} else if (lineClass == LINECLASS_VBLANKSTART) {
+				actions[1] = DOT_VBLANK;
+				continue;
+			} else if (lineClass == LINECLASS_VBLANK)
+				continue;
+
+			const bool preRender = (lineClass == LINECLASS_PRERENDER);
+			for (int pix = 0; pix < 341; pix++) {
+				const uint8_t step = (pix - 1) & 0b111;
+				if (pix == 0)
+					actions[pix] = preRender ? (rendering ? DOT_PRESTARTRENDER : DOT_PRESTART) : (rendering ? DOT_STARTRENDER : DOT_START);
+				else if (pix < 256)
+					actions[pix] = preRender ? (rendering ? DOT_PREBG(step) : DOT_SHIFT) : (rendering ? DOT_BG(step) : DOT_BGOFF);
+				else if (pix == 256)
+					actions[pix] = preRender ? (rendering ? DOT_PREBGLAST : DOT_SHIFT) : (rendering ? DOT_BGLAST : DOT_BGLASTOFF);
+				else if (pix <= 320)
+					actions[pix] = rendering ? DOT_SPR(step) : DOT_SPROFF;
+				else if (pix <= 336)
+					actions[pix] = rendering ? DOT_NEXT(step) : DOT_NEXTOFF;
+				else
+					actions[pix] = rendering ? ((pix & 1) ? DOT_GARBAGEADDR : DOT_GARBAGEREAD) : DOT_GARBAGEOFF;
+
+				// Shift registers are fed at the beginning of each tile
+				if ((step == 0 && pix != 1 && pix <= 257) || pix == 329 || pix == 337)
+					actions[pix] |= DOT_FEED;
+				if (preRender && pix == 1)
+					actions[pix] |= DOT_CLEARSTATUS;
+
+				if (rendering) {
+					// TODO coarse X is never incremented on scanline 0
+					if ((pix & 0b111) == 0 && pix != 0 && pix != 256 && (pix < 256 || pix >= 328) && lineClass != LINECLASS_FIRST)
+						actions[pix] |= DOT_INCX;
+					if (pix == 257)
+						actions[pix] |= DOT_COPYX;
+					if (preRender && pix >= 280 && pix < 305)
+						actions[pix] |= DOT_COPYY;
+					if (preRender && pix == 339)
+						actions[pix] |= DOT_ODDSKIP;
+				}
+			}
+		}
+	}
 
-	return result;
+	// Mappers watching A12 get the same tables, with a few more dots telling them about it
+	for (int lineClass = 0; lineClass < LINECLASS_COUNT; lineClass++) {
+		for (int rendering = 0; rendering < 2; rendering++) {
+			for (int a12Mode = A12_NONE + 1; a12Mode < A12_MODES; a12Mode++) {
+				uint16_t *actions = dotTables[lineClass][rendering][a12Mode];
+				memcpy(actions, dotTables[lineClass][rendering][A12_NONE], sizeof(dotTables[0][0][0]));
+				if (!rendering || lineClass == LINECLASS_POSTRENDER || lineClass == LINECLASS_VBLANKSTART || lineClass == LINECLASS_VBLANK)
+					continue;
+
+				if (a12Mode == A12_SPRITES) {
+					actions[261] |= DOT_A12RISE;
+				} else if (a12Mode == A12_BACKGROUND) {
+					actions[325] |= DOT_A12RISE;
+					if (lineClass == LINECLASS_PRERENDER)
+						actions[5] |= DOT_A12RISE;
+				} else {
+					// Addresses are put on the bus on odd dots
+					for (int pix = 2; pix < 341; pix += 2)
+						actions[pix] |= DOT_WATCHA12;
+				}
+			}
+		}
+	}
 }
 
+// Selects the dot actions of the current scanline, which only change with the scanline, when rendering is enabled or disabled, and with the pattern tables if the mapper watches A12
+void updateDotActions(PPU *ppu) {
+	uint8_t lineClass = LINECLASS_VISIBLE;
+	if (ppu->scanline == 0)
+		lineClass = LINECLASS_FIRST;
+	else if (ppu->scanline == 240)
+		lineClass = LINECLASS_POSTRENDER;
+	else if (ppu->scanline == 241)
+		lineClass = LINECLASS_VBLANKSTART;
+	else if (ppu->scanline == 261)
+		lineClass = LINECLASS_PRERENDER;
+	else if (ppu->scanline > 241)
+		lineClass = LINECLASS_VBLANK;
+
+	uint8_t a12Mode = A12_NONE;
+	if (ppu->watchA12) {
+		const uint8_t control = ppu->registers[PPUCTRL] & (CTRL_SPRSIZE | CTRL_BGPATTERN | CTRL_SPRPATTERN);
+		if (control == CTRL_SPRPATTERN)
+			a12Mode = A12_SPRITES;
+		else if (control == CTRL_BGPATTERN)
+			a12Mode = A12_BACKGROUND;
+		else
+			a12Mode = A12_WATCH;
+	}
+
+	ppu->dotActions = dotTables[lineClass][(ppu->registers[PPUMASK] & (MASK_RENDERSPR | MASK_RENDERBG)) != 0][a12Mode];
+}
 
 // Interface functions
-void initPPU(PPU *ppu, uint8_t *framebuffer, Bus *bus) {
+void initPPU(PPU *ppu, uint16_t *framebuffer, Bus *bus) {
 	// This emulates the PPU behaviour when it is first powered up after being off for some time. This is NOT perfectly good emulation for its behaviour on reset or on bootup when the NES was just recently turned off.
 	// The main differences between power and reset are various registers working immediately and their content 
 	ppu->dataBusCPU = 0;
 	ppu->addressBusLatch = 0;
 	ppu->scanline = ppu->pixel = 0;
 	// TODO do we really need OAMDATA, PPUDATA, PPUADR and PPUSCROLL as registers
-	// TODO load colors with default value
 	ppu->secondOAMptr = ppu->sprCount = ppu->sprPatternIndex = 0;
 	ppu->addressVRAM = ppu->tempAddressVRAM = ppu->readBufferVRAM = ppu->fineX = 0;
-	ppu->spriteInRange = ppu->sprZeroOnNext = ppu->sprZeroOnCurrent = ppu->secondWrite = ppu->oddFrame = false;
+	ppu->spriteInRange = ppu->sprZeroOnNext = ppu->sprZeroOnCurrent = ppu->secondWrite = ppu->oddFrame = ppu->sprEvalDeferred = false;
 
 	for (int i = 0; i < 256; i++) ppu->OAM[i] = 0x00;
 	for (int i = 0; i < 32; i++) ppu->palettes[i] = ppu->secondOAM[i] = 0x00;
 
-	ppu->bgPatternData[0] = ppu->bgPatternData[1] = 0;
+	ppu->bgPatternData = 0;
 	ppu->bgPaletteData[0] = ppu->bgPaletteData[1] = 0;
 	ppu->bgSerialPaletteLatch[0] = ppu->bgSerialPaletteLatch[1] = false;
-	ppu->bgPatternLatch[0] = ppu->bgPatternLatch[1] = 0;
+	ppu->bgPatternLatch = 0;
+	ppu->bgNametableLatch = ppu->bgPaletteLatch = 0;
 
 	for (int i = 0; i < 8; i++) {
 		ppu->registers[i] = 0;
-		ppu->sprPatternLow[i] = 0;
-		ppu->sprPatternHigh[i] = 0;
+		ppu->sprPattern[i] = 0;
 		ppu->sprAttributes[i] = 0;
 		ppu->sprXPos[i] = 0;
 	}
 
+	for (int i = 0; i < SPRLINE_SIZE; i++)
+		ppu->sprLine[i] = 0;
+	ppu->pendingCount = 0;
+	ppu->pendingPixel = 0;
+	ppu->composePixels = selectComposer();
+	ppu->skipRendering = false;
+	ppu->rasterizer = NULL;
+	ppu->loggingLine = false;
+	ppu->watchA12 = false;
+
 	ppu->allowRegWrites = true;
+	ppu->frameDone = false;
 
 	UPDATENMI(ppu);
 
@@ -158,6 +676,10 @@ void initPPU(PPU *ppu, uint8_t *framebuffer, Bus *bus) {
 	ppu->framebuffer = framebuffer;
 	ppu->bus = bus;
 
+	// Other PPUs may already be reading the tables, so they are never written again
+	pthread_once(&dotTablesBuilt, buildDotTables);
+	updateDotActions(ppu);
+
 	// TODO remove this and check palettes initial value
 	for (int i = 0; i < 32; i++) ppu->palettes[i] = i;
 }
@@ -171,6 +693,11 @@ uint8_t readRegisterPPU(PPU *ppu, uint16_t reg) {
 		case PPUADDR:
 			break;
 		case PPUSTATUS:
+			// The sprite overflow flag could have been set earlier on this scanline, which needs at least 8 sprites in range
+			if (ppu->sprEvalDeferred && !(ppu->registers[PPUSTATUS] & STATUS_OFLOW)
+				&& (ppu->registers[OAMADDR] != 0 || __builtin_popcountll(spritesInRange(ppu)) >= 8))
+				syncSpriteEvaluation(ppu);
+
 			ppu->dataBusCPU &= 0b00011111;
 			ppu->dataBusCPU |= (ppu->registers[PPUSTATUS] & 0b11100000);
 			// Clears VBlank flag and updates NMI output accordingly
@@ -179,6 +706,7 @@ uint8_t readRegisterPPU(PPU *ppu, uint16_t reg) {
 			ppu->secondWrite = false;
 			break;
 		case OAMDATA:
+			syncSpriteEvaluation(ppu);
 			if (!RENDERING(ppu))
 				ppu->registers[OAMDATA] = ppu->OAM[ppu->registers[OAMADDR]];
 			ppu->dataBusCPU = ppu->registers[OAMDATA];
@@ -189,6 +717,8 @@ uint8_t readRegisterPPU(PPU *ppu, uint16_t reg) {
 				// TODO readBufferVRAM is only updated "at the PPU's earliest convenience"
 				// TODO this is not the NES behaviour at all, just temporary to get something working
 				PUTADDRBUS(ppu, ppu->addressVRAM);
+				if (ppu->watchA12)
+					ppu->bus->cartridge->mapper->ppuA12(ppu->bus, ppu->addressVRAM);
 				ppu->readBufferVRAM = ppuRead(ppu->bus, ppu->addressVRAM);
 			} else {
 				// TODO this is handled incorrectly
@@ -207,7 +737,13 @@ void writeRegisterPPU(PPU *ppu, uint16_t reg, uint8_t value) {
 	switch (reg & 0b111) {
 		case PPUCTRL:
 			if (ppu->allowRegWrites) {
+				// Sprite size is used by sprite evaluation
+				if ((ppu->registers[PPUCTRL] ^ value) & CTRL_SPRSIZE)
+					syncSpriteEvaluation(ppu);
+				const bool patternsMoved = (ppu->registers[PPUCTRL] ^ value) & (CTRL_SPRSIZE | CTRL_BGPATTERN | CTRL_SPRPATTERN);
 				ppu->registers[PPUCTRL] = value;
+				if (ppu->watchA12 && patternsMoved)
+					updateDotActions(ppu);
 				// Updates VRAM address and NMI output
 				ppu->tempAddressVRAM &= ~(VRAM_XNAMETABLE | VRAM_YNAMETABLE);
 				ppu->tempAddressVRAM |= (value & 0b11) << 10;
@@ -217,12 +753,19 @@ void writeRegisterPPU(PPU *ppu, uint16_t reg, uint8_t value) {
 			}
 			break;
 		case PPUMASK:
-			if (ppu->allowRegWrites)
+			if (ppu->allowRegWrites) {
+				// Sprite evaluation only happens while rendering
+				if (!(ppu->registers[PPUMASK] & (MASK_RENDERSPR | MASK_RENDERBG)) != !(value & (MASK_RENDERSPR | MASK_RENDERBG)))
+					syncSpriteEvaluation(ppu);
 				ppu->registers[PPUMASK] = value;
+				updateDotActions(ppu);
+			}
 			break;
 		case PPUSTATUS:
 			break;
 		case OAMADDR:
+			syncSpriteEvaluation(ppu);
+
 			// OAM corruption
 			for (int i = 0; i < 8; i++)
 				ppu->OAM[(reg & 0xF8) + i] = ppu->OAM[(ppu->registers[OAMDATA] & 0xF8) + i];
@@ -230,6 +773,7 @@ void writeRegisterPPU(PPU *ppu, uint16_t reg, uint8_t value) {
 			ppu->registers[OAMADDR] = value;
 			break;
 		case OAMDATA:
+			syncSpriteEvaluation(ppu);
 			if (RENDERING(ppu))
 				// TODO according to NesDev, "it's plausible that it could bump the low bits instead depending on the current status of sprite evaluation"
 				ppu->registers[OAMADDR] += 4;
@@ -272,6 +816,8 @@ void writeRegisterPPU(PPU *ppu, uint16_t reg, uint8_t value) {
 				// TODO the write itself takes 2 cycles, but I'm unsure how the PPU handles this (presumably immediatly sends the low bits with /ALE, "saves" the high bits in a temporary location then, on the next cycle, sends them with /R)
 				// I can't find documentation on how the PPU handles the reads being 2 cycles, so I'll just do it in one. It's not a good solution, but at least it shouldn't have graphical implications, as this is only in VBlank.
 				PUTADDRBUS(ppu, ppu->addressVRAM);
+				if (ppu->watchA12)
+					ppu->bus->cartridge->mapper->ppuA12(ppu->bus, ppu->addressVRAM);
 				ppuWrite(ppu->bus, ppu->addressVRAM, value);
 				ppu->addressVRAM += (ppu->registers[PPUCTRL] & CTRL_ADDRINC) ? 32 : 1;
 			} else {
@@ -284,10 +830,54 @@ void writeRegisterPPU(PPU *ppu, uint16_t reg, uint8_t value) {
 	}
 }
 
-void loadPalette(PPU *ppu, uint8_t colors[192]) {
-	for (int i = 0; i < 64; i++)
-		for (int j = 0; j < 3; j++)
-			ppu->colors[i][j] = colors[i * 3 + j];
+void setRenderSkipPPU(PPU *ppu, bool skip) {
+	if (skip && ppu->loggingLine)
+		flushScanlineLog(ppu);
+	if (skip && ppu->pendingCount) {
+		ppu->composePixels(ppu);
+	} else if (!skip) {
+		// Pixels skipped so far on the current scanline weren't logged, so it can't be left to the rasterizer, and the rest of it is composed inline
+		if (ppu->skipRendering)
+			ppu->loggingLine = false;
+		// The sprite line may not have been built for the current scanline
+		buildSpriteLine(ppu);
+	}
+
+	ppu->skipRendering = skip;
+}
+
+// The rasterizer (or NULL to compose pixels during emulation) should use the same framebuffer as the PPU
+void setRasterizerPPU(PPU *ppu, Rasterizer *rasterizer) {
+	if (ppu->loggingLine)
+		flushScanlineLog(ppu);
+
+	// Scanlines already logged during this frame are composed right away
+	if (ppu->rasterizer) {
+		startRaster(ppu->rasterizer);
+		waitRaster(ppu->rasterizer);
+	}
+
+	ppu->rasterizer = rasterizer;
+}
+
+// Frames can be emulated into a different framebuffer each time, as long as the rasterizer is done with the last one (see waitRaster)
+void setFramebufferPPU(PPU *ppu, uint16_t *framebuffer) {
+	ppu->framebuffer = framebuffer;
+	if (ppu->rasterizer)
+		ppu->rasterizer->framebuffer = framebuffer;
+}
+
+// Hashes every scanline of the framebuffer, so the scanlines that changed from one frame to the next can be found without keeping the whole last frame around
+// The frame must be complete (see waitRaster), as it is read as it is
+void hashFramePPU(const PPU *ppu, uint64_t *lineHashes) {
+	for (int i = 0; i < 240; i++)
+		lineHashes[i] = hashScanline(&ppu->framebuffer[i * 256]);
+}
+
+// To be called once the cartridge is loaded, with whether its mapper watches A12 (and has the hooks for it, see Mapper)
+void setA12HooksPPU(PPU *ppu, bool watch) {
+	ppu->watchA12 = watch;
+	updateDotActions(ppu);
 }
 
 void tickPPU(PPU *ppu) {
@@ -295,282 +885,191 @@ void tickPPU(PPU *ppu) {
 	// TODO palette addressing / mirroring etc
 	// TODO when rendering starts, if OAMADDR >= 8, OAM is corrupted slightly
 	// TODO make oam[attribute] & 0b00011100 always 0
-	// TODO words cannot describe how ugly this whole thing is
-	// TODO I have no idea how any of this works, so anyone else won't either
 
-	// This is used numerous times and does not change withing a cycle so we only compute it once
-	const bool isRendering = RENDERING(ppu);
 	const uint16_t pix = ppu->pixel;
+	const uint16_t action = ppu->dotActions[pix];
 
-	// Scanline-independant logic
-	if (isRendering) {
-		if (pix == 256) {
-			incrementY(ppu);
-		} else if ((pix & 0b111) == 0 && (pix <= 256 || pix >= 328) && pix != 0 && ppu->scanline) {
+	// Flags come first, as they all happened before the rest of the dot
+	if (action & DOT_FLAGS) {
+		if (action & DOT_INCX)
 			incrementX(ppu);
-		} else if (pix == 257) {
+		if (action & DOT_COPYX) {
 			ppu->addressVRAM &= ~(VRAM_COARSEX | VRAM_XNAMETABLE);
 			ppu->addressVRAM |= ppu->tempAddressVRAM & (VRAM_COARSEX | VRAM_XNAMETABLE);
 		}
+		if (action & DOT_COPYY) {
+			ppu->addressVRAM &= ~(VRAM_COARSEY | VRAM_FINEY | VRAM_YNAMETABLE);
+			ppu->addressVRAM |= ppu->tempAddressVRAM & (VRAM_COARSEY | VRAM_FINEY | VRAM_YNAMETABLE);
+		}
+		if (action & DOT_FEED)
+			feedShiftRegisters(ppu);
+		if (action & DOT_CLEARSTATUS) {
+			ppu->registers[PPUSTATUS] = 0;
+			UPDATENMI(ppu);
+			ppu->allowRegWrites = true;
+		}
+		if (action & DOT_A12RISE)
+			ppu->bus->cartridge->mapper->scanline(ppu->bus);
+		if (action & DOT_WATCHA12)
+			ppu->bus->cartridge->mapper->ppuA12(ppu->bus, ppu->addressBusLatch);
 	}
 
-	// Visible scanlines
-	// TODO the nested if/elses are quite a pain
-	if (ppu->scanline < 240 || ppu->scanline == 261) {
-		if (pix == 0) {
-			if (ppu->scanline == 0 && ppu->oddFrame && isRendering) {
+	switch (action & DOT_OPCODE) {
+		case DOT_IDLE: break;
+
+		// Dot 0
+		case DOT_STARTRENDER:
+			if (ppu->scanline == 0 && ppu->oddFrame)
 				ppu->bgNametableLatch = ppuRead(ppu->bus, NAMETABLEADDR(ppu));
-			} else if (isRendering) {
+			else
 				PUTADDRBUS(ppu, BGPATTERNADDR(ppu));
+			// Fallthrough
+		case DOT_START:
+			// Sprites for this scanline were all fetched on the previous one
+			// When not rendering, only sprite 0 hits need them
+			if (ppu->rasterizer) {
+				ppu->rasterizer->lines[ppu->scanline].deferred = false;
+				ppu->loggingLine = true;
 			}
-				
-			if (ppu->scanline == 261) ppu->oddFrame = !ppu->oddFrame;
-			else renderPixel(ppu);
+			if (!ppu->skipRendering || ppu->sprZeroOnCurrent)
+				buildSpriteLine(ppu);
+			outputPixel(ppu);
 
 			ppu->spriteInRange = ppu->sprZeroOnNext = false;
 			ppu->secondOAMptr = ppu->sprCount = 0;
-		} else if (pix <= 256) {
-
-			// Sprite evaluation
-			if (isRendering && ppu->scanline != 261) {
-				if (pix <= 64) {
-					// Cycles 1-64 : fills the secondary OAM with 0xFF
-					if (pix & 1) {
-						// ppu->OAM[ppu->registers[OAMADDR]]; // Dummy read for future logging
-						ppu->registers[OAMDATA] = 0xFF;
-					} else {
-						ppu->secondOAM[(pix - 1) >> 1] = ppu->registers[OAMDATA];
-					}
-				} else if ((ppu->registers[OAMADDR] == 0 && pix > 66) || ((ppu->registers[OAMADDR] & 0b11111100) == 0 && ppu->sprCount >= 8)) {
-					// There are no more sprites to be evaluated
-					// The above if statement is to ensure this is reached if we reached the end of OAM without filling up secondOAM (in which case OAMADDR will always be 0) OR if we did fill it (in which case the sprite overflow bug occured, so OAMADDR will be anywhere between 0 and 3)
-					if (pix & 1) {
-						ppu->registers[OAMDATA] = ppu->OAM[ppu->registers[OAMADDR]];
-						ppu->registers[OAMADDR] &= 0b11111100;
-						// TODO fix this
-						// ppu->registers[OAMADDR] += 4;
-					} // else
-						// ppu->secondOAM[ppu->secondOAMptr]; // TODO Dummy read for future logging
-				} else {
-					// There are still sprites to be evaluated
-					// TODO maybe join spriteInRange and else together
-					if (pix & 1) ppu->registers[OAMDATA] = ppu->OAM[ppu->registers[OAMADDR]];
-					else if (ppu->spriteInRange) {
-						if (ppu->sprCount < 8)
-							ppu->secondOAM[ppu->secondOAMptr] = ppu->registers[OAMDATA];
-						// else ppu->secondOAM[ppu->secondOAMptr]; // Dummy read for future logging
-
-						ppu->registers[OAMADDR]++;
-						ppu->secondOAMptr++;
-
-						// The last byte of entry was copied
-						if ((ppu->secondOAMptr & 0b11) == 0) {
-							ppu->spriteInRange = false;
-							ppu->sprCount++;
-
-							// OAMADDR is not aligned and must be updated accordignly
-							if ((ppu->registers[OAMADDR] & 0b11) != 0)
-								ppu->registers[OAMADDR] &= 0b11111100;
-						}
-					} else {
-						if (ppu->sprCount < 8)
-							ppu->secondOAM[ppu->secondOAMptr] = ppu->registers[OAMDATA];
-						// else ppu->secondOAM[ppu->secondOAMptr]; // TODO Dummy read for future logging
-
-						// Current sprite's Y position is in range for the next scanline
-						if (ppu->scanline >= ppu->registers[OAMDATA] && ppu->scanline < ppu->registers[OAMDATA] + (ppu->registers[PPUCTRL] & CTRL_SPRSIZE ? 16 : 8)) {
-							ppu->spriteInRange = true;
-							ppu->secondOAMptr++;
-							ppu->registers[OAMADDR]++;
-
-							// Sprite zero is the first sprite read, not necessarily the one at OAM[0]
-							if (pix == 66) ppu->sprZeroOnNext = true;
-
-							// Sprite overflow occured
-							if (ppu->sprCount >= 8) ppu->registers[PPUSTATUS] |= STATUS_OFLOW;
-						} else {
-							ppu->registers[OAMADDR] += 4;
-
-							// Sprite overflow bug : both the attribute and the current sprite are incremented, without carry
-							if (ppu->sprCount >= 8 && (ppu->registers[OAMADDR] & 0b11) != 0b11)
-								ppu->registers[OAMADDR]++;
-							else
-								ppu->registers[OAMADDR] &= 0b11111100;
-						}
-					}
-				}
-			}
+			ppu->sprEvalDeferred = true;
+			break;
+		case DOT_PRESTARTRENDER:
+			PUTADDRBUS(ppu, BGPATTERNADDR(ppu));
+			// Fallthrough
+		case DOT_PRESTART:
+			ppu->oddFrame = !ppu->oddFrame;
 
-			// Status update
-			if (((pix - 1) & 0b111) == 0) {
-				if (pix != 1)
-					feedShiftRegisters(ppu);
-				else if (ppu->scanline == 261) {
-					ppu->registers[PPUSTATUS] = 0;
-					UPDATENMI(ppu);
-					ppu->allowRegWrites = true;
-				}
-			}
+			// Logged scanlines are about to be overwritten
+			if (ppu->rasterizer)
+				waitRaster(ppu->rasterizer);
 
-			// Tile fetching
-			if (isRendering) {
-				switch ((pix - 1) & 0b111) {
-					case 0b000: PUTADDRBUS(ppu, NAMETABLEADDR(ppu)); break;
-					case 0b001: ppu->bgNametableLatch = ppuRead(ppu->bus, NAMETABLEADDR(ppu)); break;
-					case 0b010: PUTADDRBUS(ppu, ATTRIBUTEADDR(ppu)); break;
-					case 0b011: ppu->bgPaletteLatch = ppuRead(ppu->bus, ATTRIBUTEADDR(ppu)); ppu->bgPaletteLatch >>= ((ppu->addressVRAM & 0b1000000) >> 4) | (ppu->addressVRAM & 0b10); break;
-					case 0b100: PUTADDRBUS(ppu, BGPATTERNADDR(ppu)); break;
-					case 0b101: ppu->bgPatternLatch[0] = ppuRead(ppu->bus, BGPATTERNADDR(ppu)); break;
-					case 0b110: PUTADDRBUS(ppu, 0b1000 | BGPATTERNADDR(ppu)); break;
-					case 0b111: ppu->bgPatternLatch[1] = ppuRead(ppu->bus, 0b1000 | BGPATTERNADDR(ppu)); break;
-				}
-			}
-			
-			// Color output
-			if (ppu->scanline != 261) renderPixel(ppu);
+			ppu->spriteInRange = ppu->sprZeroOnNext = false;
+			ppu->secondOAMptr = ppu->sprCount = 0;
+			ppu->sprEvalDeferred = false;
+			break;
 
-			// Status update 2: Electric Boogaloo
-			shiftRegistersPPU(ppu);
+		// Dots 1-256 of visible scanlines: sprite evaluation, background fetches and color output
+		case DOT_BG(0): EVALUATE(ppu, pix); fetchBackground(ppu, 0); outputPixel(ppu); shiftRegistersPPU(ppu); break;
+		case DOT_BG(1): EVALUATE(ppu, pix); fetchBackground(ppu, 1); outputPixel(ppu); shiftRegistersPPU(ppu); break;
+		case DOT_BG(2): EVALUATE(ppu, pix); fetchBackground(ppu, 2); outputPixel(ppu); shiftRegistersPPU(ppu); break;
+		case DOT_BG(3): EVALUATE(ppu, pix); fetchBackground(ppu, 3); outputPixel(ppu); shiftRegistersPPU(ppu); break;
+		case DOT_BG(4): EVALUATE(ppu, pix); fetchBackground(ppu, 4); outputPixel(ppu); shiftRegistersPPU(ppu); break;
+		case DOT_BG(5): EVALUATE(ppu, pix); fetchBackground(ppu, 5); outputPixel(ppu); shiftRegistersPPU(ppu); break;
+		case DOT_BG(6): EVALUATE(ppu, pix); fetchBackground(ppu, 6); outputPixel(ppu); shiftRegistersPPU(ppu); break;
+		case DOT_BG(7): EVALUATE(ppu, pix); fetchBackground(ppu, 7); outputPixel(ppu); shiftRegistersPPU(ppu); break;
+		case DOT_BGLAST:
+			incrementY(ppu);
 
-		} else if (pix <= 320) {
-			// Status update
-			ppu->sprZeroOnCurrent = ppu->sprZeroOnNext;
-			ppu->registers[OAMADDR] = 0;
+			// Sprite evaluation, deferred to the end of the scanline unless something could observe it
+			if (ppu->sprEvalDeferred) {
+				ppu->sprEvalDeferred = false;
+				evaluateSpritesBatched(ppu);
+			} else
+				evaluateSpriteDot(ppu, pix);
 
-			if (pix >= 280 && pix < 305 && ppu->scanline == 261 && isRendering) {
-				ppu->addressVRAM &= ~(VRAM_COARSEY | VRAM_FINEY | VRAM_YNAMETABLE);
-				ppu->addressVRAM |= ppu->tempAddressVRAM & (VRAM_COARSEY | VRAM_FINEY | VRAM_YNAMETABLE);
-			} else if (pix == 257) {
-				feedShiftRegisters(ppu);
-			}
+			fetchBackground(ppu, 7);
+			outputPixel(ppu);
+			shiftRegistersPPU(ppu);
+			break;
+		case DOT_BGOFF:
+			outputPixel(ppu);
+			shiftRegistersPPU(ppu);
+			break;
+		case DOT_BGLASTOFF:
+			ppu->sprEvalDeferred = false;
+			outputPixel(ppu);
+			shiftRegistersPPU(ppu);
+			break;
 
-			// Sprite evaluation & tile fetching
-			if (isRendering) {
-				const uint8_t currentOAM = ((pix - 1) & 0b11) | (((pix - 1) >> 1) & 0b11100);
-				const uint8_t currentSprite = ((pix - 1) >> 3) & 0b111;
-				switch ((pix - 1) & 0b111) {
-					case 0b000:
-						// Sprite Y position
-						ppu->registers[OAMDATA] = ppu->secondOAM[currentOAM];
-						ppu->sprPatternIndex = ppu->scanline - ppu->registers[OAMDATA];
-
-						// Garbage nametable
-						PUTADDRBUS(ppu, NAMETABLEADDR(ppu));
-						break;
-					case 0b001:
-						// Sprite index
-						ppu->registers[OAMDATA] = ppu->secondOAM[currentOAM];
-						ppu->sprPatternIndex |= ppu->registers[OAMDATA] << 4;
-
-						// Garbage nametable
-						ppuRead(ppu->bus, NAMETABLEADDR(ppu));
-						break;
-					case 0b010:
-						// Sprite attributes
-						ppu->registers[OAMDATA] = ppu->secondOAM[currentOAM];
-						ppu->sprAttributes[currentSprite] = ppu->registers[OAMDATA];
-						if (ppu->registers[OAMDATA] & SPR_VERTSYMMETRY) {
-							// TODO maybe add macros for those pattern bitmaps ?
-							// Individual tile is flipped, whether in 8x8 or 8x16 mode
-							ppu->sprPatternIndex = (ppu->sprPatternIndex & 0b111111111000) | (7 - (ppu->sprPatternIndex & 0b111)); // Vertical symmetry, if applicable
-							if (ppu->registers[PPUCTRL] & CTRL_SPRSIZE) {
-								// In 8x16 mode, the top and bottom halves are switched in addition to each being flipped individually
-								ppu->sprPatternIndex ^= 0b1000; // Switch the bit selecting top or bottom half of 8x16 sprite
-							}
-						}
-
-						// Garbage attribute table
-						PUTADDRBUS(ppu, ATTRIBUTEADDR(ppu));
-						break;
-					case 0b011:
-						// Sprite X position
-						ppu->registers[OAMDATA] = ppu->secondOAM[currentOAM];
-						ppu->sprXPos[currentSprite] = ppu->registers[OAMDATA];
-
-						// Garbage attribute table
-						ppuRead(ppu->bus, ATTRIBUTEADDR(ppu));
-						break;
-					case 0b100:
-						// Garbage OAM read
-						ppu->registers[OAMDATA] = ppu->secondOAM[currentOAM | 0b11];
-
-						// Sprite pattern fetch
-						PUTADDRBUS(ppu, SPRPATTERNADDR(ppu));
-						break;
-					case 0b101:
-						// Garbage OAM read
-						ppu->registers[OAMDATA] = ppu->secondOAM[currentOAM | 0b11];
-
-						// Sprite pattern fetch
-						ppu->sprPatternLow[currentSprite] = ppuRead(ppu->bus, SPRPATTERNADDR(ppu));
-						if (currentSprite >= ppu->sprCount)
-							ppu->sprPatternLow[currentSprite] = 0x00;
-						else if (ppu->sprAttributes[currentSprite] & SPR_HORSYMMETRY)
-							ppu->sprPatternLow[currentSprite] = flipByte(ppu->sprPatternLow[currentSprite]); // Horizontal symmetry, if applicable
-						break;
-					case 0b110:
-						// Garbage OAM read and sprite high pattern fetch
-						ppu->registers[OAMDATA] = ppu->secondOAM[currentOAM | 0b11];
-						PUTADDRBUS(ppu, 0b1000 | SPRPATTERNADDR(ppu));
-						break;
-					case 0b111:
-						// Garbage OAM read and sprite high pattern fetch
-						ppu->registers[OAMDATA] = ppu->secondOAM[currentOAM | 0b11];
-						ppu->sprPatternHigh[currentSprite] = ppuRead(ppu->bus, 0b1000 | SPRPATTERNADDR(ppu));
-						if (currentSprite >= ppu->sprCount)
-							ppu->sprPatternHigh[currentSprite] = 0x00;
-						else if (ppu->sprAttributes[currentSprite] & SPR_HORSYMMETRY)
-							ppu->sprPatternHigh[currentSprite] = flipByte(ppu->sprPatternHigh[currentSprite]); // Horizontal symmetry, if applicable
-						break;
-				}
-			}
+		// Dots 1-256 of the pre-render scanline: background fetches only
+		case DOT_PREBG(0): fetchBackground(ppu, 0); shiftRegistersPPU(ppu); break;
+		case DOT_PREBG(1): fetchBackground(ppu, 1); shiftRegistersPPU(ppu); break;
+		case DOT_PREBG(2): fetchBackground(ppu, 2); shiftRegistersPPU(ppu); break;
+		case DOT_PREBG(3): fetchBackground(ppu, 3); shiftRegistersPPU(ppu); break;
+		case DOT_PREBG(4): fetchBackground(ppu, 4); shiftRegistersPPU(ppu); break;
+		case DOT_PREBG(5): fetchBackground(ppu, 5); shiftRegistersPPU(ppu); break;
+		case DOT_PREBG(6): fetchBackground(ppu, 6); shiftRegistersPPU(ppu); break;
+		case DOT_PREBG(7): fetchBackground(ppu, 7); shiftRegistersPPU(ppu); break;
+		case DOT_PREBGLAST:
+			incrementY(ppu);
+			fetchBackground(ppu, 7);
+			shiftRegistersPPU(ppu);
+			break;
+		case DOT_SHIFT:
+			shiftRegistersPPU(ppu);
+			break;
 
+		// Dots 257-320: sprite fetches for the next scanline
+		case DOT_SPR(0): ppu->sprZeroOnCurrent = ppu->sprZeroOnNext; ppu->registers[OAMADDR] = 0; fetchSprite(ppu, pix, 0); shiftRegistersPPU(ppu); break;
+		case DOT_SPR(1): ppu->sprZeroOnCurrent = ppu->sprZeroOnNext; ppu->registers[OAMADDR] = 0; fetchSprite(ppu, pix, 1); shiftRegistersPPU(ppu); break;
+		case DOT_SPR(2): ppu->sprZeroOnCurrent = ppu->sprZeroOnNext; ppu->registers[OAMADDR] = 0; fetchSprite(ppu, pix, 2); shiftRegistersPPU(ppu); break;
+		case DOT_SPR(3): ppu->sprZeroOnCurrent = ppu->sprZeroOnNext; ppu->registers[OAMADDR] = 0; fetchSprite(ppu, pix, 3); shiftRegistersPPU(ppu); break;
+		case DOT_SPR(4): ppu->sprZeroOnCurrent = ppu->sprZeroOnNext; ppu->registers[OAMADDR] = 0; fetchSprite(ppu, pix, 4); shiftRegistersPPU(ppu); break;
+		case DOT_SPR(5): ppu->sprZeroOnCurrent = ppu->sprZeroOnNext; ppu->registers[OAMADDR] = 0; fetchSprite(ppu, pix, 5); shiftRegistersPPU(ppu); break;
+		case DOT_SPR(6): ppu->sprZeroOnCurrent = ppu->sprZeroOnNext; ppu->registers[OAMADDR] = 0; fetchSprite(ppu, pix, 6); shiftRegistersPPU(ppu); break;
+		case DOT_SPR(7): ppu->sprZeroOnCurrent = ppu->sprZeroOnNext; ppu->registers[OAMADDR] = 0; fetchSprite(ppu, pix, 7); shiftRegistersPPU(ppu); break;
+		case DOT_SPROFF:
+			ppu->sprZeroOnCurrent = ppu->sprZeroOnNext;
+			ppu->registers[OAMADDR] = 0;
 			shiftRegistersPPU(ppu);
+			break;
 
-		} else if (pix <= 336) {
-			// TODO this repeats pixel <= 256
-			// Status update
+		// Dots 321-336: first two tiles of the next scanline
+		case DOT_NEXT(0): ppu->registers[OAMDATA] = ppu->secondOAM[0]; fetchBackground(ppu, 0); shiftRegistersPPU(ppu); break;
+		case DOT_NEXT(1): ppu->registers[OAMDATA] = ppu->secondOAM[0]; fetchBackground(ppu, 1); shiftRegistersPPU(ppu); break;
+		case DOT_NEXT(2): ppu->registers[OAMDATA] = ppu->secondOAM[0]; fetchBackground(ppu, 2); shiftRegistersPPU(ppu); break;
+		case DOT_NEXT(3): ppu->registers[OAMDATA] = ppu->secondOAM[0]; fetchBackground(ppu, 3); shiftRegistersPPU(ppu); break;
+		case DOT_NEXT(4): ppu->registers[OAMDATA] = ppu->secondOAM[0]; fetchBackground(ppu, 4); shiftRegistersPPU(ppu); break;
+		case DOT_NEXT(5): ppu->registers[OAMDATA] = ppu->secondOAM[0]; fetchBackground(ppu, 5); shiftRegistersPPU(ppu); break;
+		case DOT_NEXT(6): ppu->registers[OAMDATA] = ppu->secondOAM[0]; fetchBackground(ppu, 6); shiftRegistersPPU(ppu); break;
+		case DOT_NEXT(7): ppu->registers[OAMDATA] = ppu->secondOAM[0]; fetchBackground(ppu, 7); shiftRegistersPPU(ppu); break;
+		case DOT_NEXTOFF:
 			ppu->registers[OAMDATA] = ppu->secondOAM[0];
-			if (pix == 329) feedShiftRegisters(ppu);
-
-			if (isRendering) {
-				switch ((pix - 1) & 0b111) {
-					case 0b000: PUTADDRBUS(ppu, NAMETABLEADDR(ppu)); break;
-					case 0b001: ppu->bgNametableLatch = ppuRead(ppu->bus, NAMETABLEADDR(ppu)); break;
-					case 0b010: PUTADDRBUS(ppu, ATTRIBUTEADDR(ppu)); break;
-					case 0b011: ppu->bgPaletteLatch = ppuRead(ppu->bus, ATTRIBUTEADDR(ppu)); ppu->bgPaletteLatch >>= ((ppu->addressVRAM & 0b1000000) >> 4) | (ppu->addressVRAM & 0b10); break;
-					case 0b100: PUTADDRBUS(ppu, BGPATTERNADDR(ppu)); break;
-					case 0b101: ppu->bgPatternLatch[0] = ppuRead(ppu->bus, BGPATTERNADDR(ppu)); break;
-					case 0b110: PUTADDRBUS(ppu, 0b1000 | BGPATTERNADDR(ppu)); break;
-					case 0b111: ppu->bgPatternLatch[1] = ppuRead(ppu->bus, 0b1000 | BGPATTERNADDR(ppu)); break;
-				}
-			}
-
 			shiftRegistersPPU(ppu);
+			break;
 
-		} else {
+		// Dots 337-340: garbage nametable fetches
+		case DOT_GARBAGEADDR:
+			ppu->registers[OAMDATA] = ppu->secondOAM[0];
+			PUTADDRBUS(ppu, NAMETABLEADDR(ppu));
+			break;
+		case DOT_GARBAGEREAD:
 			ppu->registers[OAMDATA] = ppu->secondOAM[0];
-			if (pix == 337) feedShiftRegisters(ppu);
+			ppu->bgNametableLatch = ppuRead(ppu->bus, NAMETABLEADDR(ppu));
+			break;
+		case DOT_GARBAGEOFF:
+			ppu->registers[OAMDATA] = ppu->secondOAM[0];
+			break;
 
-			if (isRendering) {
-				if (pix & 0b1)
-					PUTADDRBUS(ppu, NAMETABLEADDR(ppu));
-				else
-					ppu->bgNametableLatch = ppuRead(ppu->bus, NAMETABLEADDR(ppu));
-			}
-		}
-	} else if (ppu->scanline == 241 && pix == 1) {
-		ppu->registers[PPUSTATUS] |= STATUS_VBLANK;
-		UPDATENMI(ppu);
+		// Post-render and VBlank scanlines
+		case DOT_FRAMEDONE:
+			// The whole frame was output
+			if (ppu->rasterizer)
+				startRaster(ppu->rasterizer);
+			ppu->frameDone = true;
+			break;
+		case DOT_VBLANK:
+			ppu->registers[PPUSTATUS] |= STATUS_VBLANK;
+			UPDATENMI(ppu);
+			break;
 	}
 
 	if (++ppu->pixel == 341) {
 		ppu->pixel = 0;
 		ppu->scanline++;
 		if (ppu->scanline == 262) ppu->scanline = 0;
-	} else if (ppu->pixel == 340 && ppu->scanline == 261 && ppu->oddFrame && isRendering) {
+		updateDotActions(ppu);
+	} else if ((action & DOT_ODDSKIP) && ppu->oddFrame) {
+		// Dot 340 of the pre-render scanline is skipped on odd frames
 		ppu->pixel = 0;
 		ppu->scanline = 0;
+		updateDotActions(ppu);
 	}
 }
 
@@ -578,4 +1077,5 @@ void tickPPU(PPU *ppu) {
 //#undef NAMETABLEADDR TODO uncomment
 #undef ATTRIBUTEADDR
 #undef BGPATTERNADDR
-#undef SPRPATTERNADDR
\ No newline at end of file
+#undef SPRPATTERNADDR
+#undef EVALUATE
\ No newline at end of file
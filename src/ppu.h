@@ -47,6 +47,20 @@
 #define SPR_HORSYMMETRY 0b01000000
 #define SPR_VERTSYMMETRY 0b10000000
 
+// Framebuffer pixels are palette indices, converted to RGB only when displayed: 6-bit color (greyscale already applied) and the emphasis bits of PPUMASK
+#define PIXEL_COLOR 0b000111111
+#define PIXEL_EMPHASIS 0b111000000
+#define PIXEL(color, mask) ((color) | (((mask) & MASK_EMPHASIS) << 1))
+
+// Pixels output by the sprite units for a whole scanline, padded so 16 pixels can always be loaded at once
+#define SPRLINE_SIZE 272
+
+// Composes the pending pixels into the framebuffer (scalar or vectorized, see compose.h)
+typedef void (*ComposeFunction)(PPU *ppu);
+
+// Forward declaration so there is no circular dependency (see raster.h)
+typedef struct Rasterizer Rasterizer;
+
 typedef struct PPU {
 	// Registers and CPU / PPU interface
 	uint8_t registers[8];
@@ -57,9 +71,6 @@ typedef struct PPU {
 	uint8_t secondOAM[32];
 	uint8_t palettes[32];
 
-	// Color emulation
-	uint8_t colors[64][3];
-
 	// Internal sprite evaluation counters and flags
 	uint8_t secondOAMptr; // Pointer to next free second OAM location / next second OAM location to be evaluated
 	bool spriteInRange; // The sprite being evaluated is on next scanline (copy it to second OAM)
@@ -69,6 +80,7 @@ typedef struct PPU {
 	// sprPatternIndex is constructed as such: (y line of sprite selected between 0-8 or 0-16 in 8x16 mode) for the bottom 4 bits, and (OAM byte 1: tile index number) for bits 5-12, and is modified for vertical flipping if needed
 	bool sprZeroOnNext; // Sprite zero detected to be in next scanline
 	bool sprZeroOnCurrent; // Initialized from sprZeroOnNext for current scanline
+	bool sprEvalDeferred; // Sprite evaluation for this scanline is done all at once on dot 256, unless the CPU accesses something it depends on before (see syncSpriteEvaluation)
 
 	// Internal registers for fetching and rendering
 	uint16_t addressVRAM; // Also called 'v'
@@ -78,10 +90,10 @@ typedef struct PPU {
 	bool secondWrite; // Next write to PPUSCROLL or PPUADDR is the second
 
 	// Internal registers / shift registers when fetching tile data
-	uint16_t bgPatternData[2];
+	// Pattern data is kept pre-decoded (2 bits per pixel, both planes interleaved) as it comes from the cartridge's tile cache
+	uint32_t bgPatternData;
 	uint8_t bgPaletteData[2];
-	uint8_t sprPatternLow[8];
-	uint8_t sprPatternHigh[8];
+	uint16_t sprPattern[8];
 	uint8_t sprAttributes[8];
 	uint8_t sprXPos[8];
 
@@ -89,33 +101,58 @@ typedef struct PPU {
 	uint8_t bgNametableLatch;
 	uint8_t bgPaletteLatch;
 	bool bgSerialPaletteLatch[2];
-	uint8_t bgPatternLatch[2];
+	uint16_t bgPatternLatch;
+
+	// Pixels are composed in batches of up to 16 (see compose.h)
+	// Only what can change from one pixel to the next is kept for each pending pixel, as the sprite units' output doesn't change during a scanline
+	uint8_t sprLine[SPRLINE_SIZE]; // Output of the sprite units for the current scanline
+	uint8_t pendingBg[16]; // Background palette index of each pending pixel
+	uint8_t pendingMask[16]; // PPUMASK when each pending pixel was output
+	uint8_t pendingCount;
+	uint16_t pendingPixel; // Position of the first pending pixel on the scanline
+	ComposeFunction composePixels;
+
+	// When set, scanlines are logged and composed after the frame by the rasterizer, unless rendering is disabled during the scanline
+	Rasterizer *rasterizer;
+	bool loggingLine; // Pixels of the current scanline are logged rather than composed
 
 	// Internal flags
 	bool allowRegWrites;
 	bool oddFrame;
 
-	// External latch for VRAM access
-	uint8_t addressBusLatch;
+	// Frames aren't displayed: everything observable (VRAM fetches, sprite evaluation, sprite 0 hits, NMI) is emulated, but pixels aren't composed nor written to the framebuffer
+	bool skipRendering;
+
+	// Last address put on the VRAM bus (only its low byte is actually latched, but mappers watching A12 need the rest)
+	uint16_t addressBusLatch;
+	bool watchA12; // The mapper watches the PPU address bus through its hooks (see setA12HooksPPU)
 
 	// VBL pin connected to the NMI pin of the 6502
 	bool outInterrupt;
 
+	// Set once the last visible scanline was output, and left for whoever consumes frames to clear
+	bool frameDone;
+
 	uint16_t scanline;
 	uint16_t pixel;
+	const uint16_t *dotActions; // What to do on each dot of the current scanline (see tickPPU)
 
-	uint8_t *framebuffer;
+	uint16_t *framebuffer;
 
 	Bus *bus;
 } PPU;
 
 
 // Interface functions
-void initPPU(PPU *ppu, uint8_t *framebuffer, Bus *bus);
+void initPPU(PPU *ppu, uint16_t *framebuffer, Bus *bus);
 void tickPPU(PPU *ppu);
 uint8_t readRegisterPPU(PPU *ppu, uint16_t reg);
 void writeRegisterPPU(PPU *ppu, uint16_t reg, uint8_t value);
-void loadPalette(PPU *ppu, uint8_t values[192]);
+void setRenderSkipPPU(PPU *ppu, bool skip);
+void setRasterizerPPU(PPU *ppu, Rasterizer *rasterizer);
+void setFramebufferPPU(PPU *ppu, uint16_t *framebuffer);
+void hashFramePPU(const PPU *ppu, uint64_t *lineHashes);
+void setA12HooksPPU(PPU *ppu, bool watch);
 
 // Non-interface functions
 void shiftRegistersPPU(PPU *ppu);
@@ -123,6 +160,7 @@ void incrementX(PPU *ppu);
 void incrementY(PPU *ppu);
 void feedShiftRegisters(PPU *ppu);
 void renderPixel(PPU *ppu);
-uint8_t flipByte(uint8_t value);
+void outputPixel(PPU *ppu);
+uint64_t hashScanline(const uint16_t *line);
 
 #endif // ifndef PPU_H
\ No newline at end of file
@@ -0,0 +1,140 @@
+#include "raster.h"
+#include "compose.h"
+
+#include <string.h>
+
+
+// Non-interface functions
+// ppu is a scratch PPU, only used to feed the composer
+void rasterizeScanline(Rasterizer *raster, PPU *ppu, int scanline) {
+	const ScanlineLog *log = &raster->lines[scanline];
+	if (!log->deferred)
+		return;
+
+	memcpy(ppu->sprLine, log->sprLine, SPRLINE_SIZE);
+	memcpy(ppu->palettes, log->palettes, 32);
+	ppu->scanline = scanline;
+	for (int pix = 0; pix < 256; pix += 16) {
+		memcpy(ppu->pendingBg, &log->bg[pix], 16);
+		memcpy(ppu->pendingMask, &log->mask[pix], 16);
+		ppu->pendingPixel = pix;
+		ppu->pendingCount = 16;
+		raster->composePixels(ppu);
+	}
+}
+
+// Takes scanlines in batches until there are none left in the frame
+void rasterizeLines(Rasterizer *raster, PPU *ppu) {
+	int first;
+	while ((first = __atomic_fetch_add(&raster->nextLine, RASTER_BATCHLINES, __ATOMIC_RELAXED)) < 240) {
+		for (int i = first; i < first + RASTER_BATCHLINES && i < 240; i++)
+			rasterizeScanline(raster, ppu, i);
+	}
+}
+
+void *rasterWorker(void *arg) {
+	Rasterizer *raster = (Rasterizer *)arg;
+	PPU ppu;
+	uint32_t frame = 0;
+
+	pthread_mutex_lock(&raster->lock);
+	while (true) {
+		while (raster->frame == frame && !raster->quit)
+			pthread_cond_wait(&raster->frameStarted, &raster->lock);
+		if (raster->quit)
+			break;
+		frame = raster->frame;
+		ppu.framebuffer = raster->framebuffer;
+		pthread_mutex_unlock(&raster->lock);
+
+		rasterizeLines(raster, &ppu);
+
+		pthread_mutex_lock(&raster->lock);
+		if (--raster->workersBusy == 0)
+			pthread_cond_signal(&raster->frameDone);
+	}
+	pthread_mutex_unlock(&raster->lock);
+
+	return NULL;
+}
+
+
+// Interface functions
+// With no worker threads, frames are rasterized by startRaster on the calling thread
+int initRasterizer(Rasterizer *raster, uint16_t *framebuffer, int threadCount) {
+	if (threadCount < 0 || threadCount > RASTER_MAXTHREADS) {
+		printf("Error : invalid number of rasterizer threads (%i).\n", threadCount);
+		return -0x01;
+	}
+
+	for (int i = 0; i < 240; i++)
+		raster->lines[i].deferred = false;
+	raster->framebuffer = framebuffer;
+	raster->composePixels = selectComposer();
+	raster->frame = 0;
+	raster->nextLine = 240;
+	raster->workersBusy = 0;
+	raster->quit = false;
+
+	pthread_mutex_init(&raster->lock, NULL);
+	pthread_cond_init(&raster->frameStarted, NULL);
+	pthread_cond_init(&raster->frameDone, NULL);
+
+	for (raster->threadCount = 0; raster->threadCount < threadCount; raster->threadCount++) {
+		if (pthread_create(&raster->threads[raster->threadCount], NULL, rasterWorker, raster) != 0) {
+			printf("Error : couldn't create rasterizer thread.\n");
+			terminateRasterizer(raster);
+			return -0x02;
+		}
+	}
+
+	return 0;
+}
+
+void terminateRasterizer(Rasterizer *raster) {
+	pthread_mutex_lock(&raster->lock);
+	raster->quit = true;
+	pthread_cond_broadcast(&raster->frameStarted);
+	pthread_mutex_unlock(&raster->lock);
+
+	for (int i = 0; i < raster->threadCount; i++)
+		pthread_join(raster->threads[i], NULL);
+	raster->threadCount = 0;
+
+	pthread_cond_destroy(&raster->frameDone);
+	pthread_cond_destroy(&raster->frameStarted);
+	pthread_mutex_destroy(&raster->lock);
+}
+
+// Called once the last visible scanline was emulated; logged scanlines must not be touched until waitRaster returns
+void startRaster(Rasterizer *raster) {
+	// Frames skipped or without rendering have nothing left to compose
+	bool deferred = false;
+	for (int i = 0; i < 240 && !deferred; i++)
+		deferred = raster->lines[i].deferred;
+	if (!deferred)
+		return;
+
+	if (raster->threadCount == 0) {
+		PPU ppu;
+		ppu.framebuffer = raster->framebuffer;
+		raster->nextLine = 0;
+		rasterizeLines(raster, &ppu);
+		return;
+	}
+
+	pthread_mutex_lock(&raster->lock);
+	raster->nextLine = 0;
+	raster->workersBusy = raster->threadCount;
+	raster->frame++;
+	pthread_cond_broadcast(&raster->frameStarted);
+	pthread_mutex_unlock(&raster->lock);
+}
+
+// Waits until the last frame started is in the framebuffer
+void waitRaster(Rasterizer *raster) {
+	pthread_mutex_lock(&raster->lock);
+	while (raster->workersBusy)
+		pthread_cond_wait(&raster->frameDone, &raster->lock);
+	pthread_mutex_unlock(&raster->lock);
+}
\ No newline at end of file
@@ -0,0 +1,48 @@
+#ifndef RASTER_H
+#define RASTER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "ppu.h"
+
+#define RASTER_MAXTHREADS 16
+// Number of scanlines taken at once by a worker
+#define RASTER_BATCHLINES 8
+
+// Everything needed to compose a scanline after it was emulated
+// Background pixels are logged as they come out of the shift registers: fetching them again would need the state of the cartridge (and its side effects) at the time
+typedef struct ScanlineLog {
+	uint8_t bg[256]; // Background palette index of each pixel
+	uint8_t mask[256]; // PPUMASK when each pixel was output
+	uint8_t sprLine[SPRLINE_SIZE]; // Output of the sprite units (see compose.h)
+	uint8_t palettes[32]; // Palettes can't be written while rendering, so they can't change during a logged scanline
+	bool deferred; // Left to the rasterizer, rather than composed during emulation
+} ScanlineLog;
+
+// Composes logged scanlines into the framebuffer once a frame is emulated, on a pool of worker threads
+typedef struct Rasterizer {
+	ScanlineLog lines[240];
+	uint16_t *framebuffer;
+	ComposeFunction composePixels;
+
+	pthread_t threads[RASTER_MAXTHREADS];
+	int threadCount;
+
+	pthread_mutex_t lock;
+	pthread_cond_t frameStarted; // Workers wait on this until there is a frame to rasterize (or they have to quit)
+	pthread_cond_t frameDone;
+	uint32_t frame; // Incremented every time a frame is started
+	int nextLine; // Next scanline to be taken by a worker, atomically incremented
+	int workersBusy; // Number of workers still rasterizing the current frame
+	bool quit;
+} Rasterizer;
+
+// Interface functions
+int initRasterizer(Rasterizer *raster, uint16_t *framebuffer, int threadCount);
+void terminateRasterizer(Rasterizer *raster);
+void startRaster(Rasterizer *raster);
+void waitRaster(Rasterizer *raster);
+
+#endif // ifndef RASTER_H
\ No newline at end of file
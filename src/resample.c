@@ -0,0 +1,171 @@
+#include "resample.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define RESAMPLE_X86
+#include <immintrin.h>
+#endif
+
+
+// Non-interface functions
+// Modified Bessel function of the first kind, of order 0, from its power series
+double besselI0(double x) {
+	double sum = 1, term = 1;
+	for (int k = 1; term > sum * 1e-12; k++) {
+		term *= (x / (2 * k)) * (x / (2 * k));
+		sum += term;
+	}
+	return sum;
+}
+
+void buildKernel(Resampler *resampler) {
+	const double pi = 3.14159265358979323846;
+	// Cutoff frequency relative to the input Nyquist frequency: when downsampling, everything above the output Nyquist frequency has to go
+	double cutoff = RESAMPLER_CUTOFF;
+	if (resampler->outputRate < resampler->inputRate)
+		cutoff *= resampler->outputRate / resampler->inputRate;
+
+	for (int phase = 0; phase <= RESAMPLER_PHASES; phase++) {
+		double taps[RESAMPLER_TAPS];
+		double sum = 0;
+		for (int i = 0; i < RESAMPLER_TAPS; i++) {
+			// Distance from the output sample, which lies between the two middle taps
+			const double x = i - (RESAMPLER_TAPS / 2 - 1) - (double)phase / RESAMPLER_PHASES;
+			const double ratio = x / (RESAMPLER_TAPS / 2);
+			const double window = (ratio * ratio < 1) ? besselI0(RESAMPLER_BETA * sqrt(1 - ratio * ratio)) / besselI0(RESAMPLER_BETA) : 0;
+			const double sinc = (x == 0) ? 1 : sin(pi * cutoff * x) / (pi * cutoff * x);
+			taps[i] = window * sinc;
+			sum += taps[i];
+		}
+
+		// Every phase has a gain of exactly 1 at DC, so interpolating between phases doesn't modulate the output
+		for (int i = 0; i < RESAMPLER_TAPS; i++)
+			resampler->kernel[phase][i] = (float)(taps[i] / sum);
+	}
+}
+
+#ifdef RESAMPLE_X86
+// Sums the four lanes of v
+static inline __attribute__((target("sse2"))) float sumLanes(__m128 v) {
+	v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+	v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 0b01));
+	return _mm_cvtss_f32(v);
+}
+#endif // ifdef RESAMPLE_X86
+
+
+// Interface functions
+ConvolveFunction selectConvolver(void) {
+#ifdef RESAMPLE_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx"))
+		return convolveAVX;
+	if (__builtin_cpu_supports("sse2"))
+		return convolveSSE;
+#endif
+	return convolveScalar;
+}
+
+void initResampler(Resampler *resampler, double inputRate, double outputRate) {
+	resampler->inputRate = inputRate;
+	resampler->outputRate = outputRate;
+	resampler->convolve = selectConvolver();
+	buildKernel(resampler);
+	adjustRateResampler(resampler, 0);
+	clearResampler(resampler);
+}
+
+// Changes the number of input samples per output sample by adjustment (relative), keeping the kernel as is
+void adjustRateResampler(Resampler *resampler, double adjustment) {
+	resampler->step = resampler->inputRate / resampler->outputRate * (1 + adjustment);
+}
+
+void clearResampler(Resampler *resampler) {
+	resampler->position = 0;
+	resampler->count = 0;
+	memset(resampler->buffer, 0, sizeof(resampler->buffer));
+}
+
+// Adds up to count input samples, and returns how many were added
+uint32_t writeResampler(Resampler *resampler, const float *in, uint32_t count) {
+	if (count > RESAMPLER_SIZE - resampler->count)
+		count = RESAMPLER_SIZE - resampler->count;
+	memcpy(&resampler->buffer[resampler->count], in, count * sizeof(float));
+	resampler->count += count;
+	return count;
+}
+
+// Outputs up to count samples, as long as there are enough input samples for them, and returns how many were output
+// With out set to NULL, samples are skipped without being computed
+uint32_t readResampler(Resampler *resampler, float *out, uint32_t count) {
+	double position = resampler->position;
+	uint32_t output = 0;
+	for (; output < count; output++) {
+		const uint32_t start = (uint32_t)position;
+		if (start + RESAMPLER_TAPS > resampler->count)
+			break;
+
+		if (out != NULL) {
+			const double phase = (position - start) * RESAMPLER_PHASES;
+			const uint32_t index = (uint32_t)phase;
+			out[output] = resampler->convolve(&resampler->buffer[start], resampler->kernel[index], (float)(phase - index));
+		}
+		position += resampler->step;
+	}
+
+	// Input samples no output sample needs anymore are dropped from the start of the buffer
+	uint32_t consumed = (uint32_t)position;
+	if (consumed > resampler->count)
+		consumed = resampler->count;
+	memmove(resampler->buffer, &resampler->buffer[consumed], (resampler->count - consumed) * sizeof(float));
+	resampler->count -= consumed;
+	resampler->position = position - consumed;
+
+	return output;
+}
+
+// kernel points to a phase of the kernel, immediately followed by the next one
+float convolveScalar(const float *input, const float *kernel, float fraction) {
+	float sum = 0, nextSum = 0;
+	for (int i = 0; i < RESAMPLER_TAPS; i++) {
+		sum += input[i] * kernel[i];
+		nextSum += input[i] * kernel[RESAMPLER_TAPS + i];
+	}
+	return sum + (nextSum - sum) * fraction;
+}
+
+#ifdef RESAMPLE_X86
+// Phases of the kernel are aligned (unless the resampler itself isn't), input samples generally aren't, so both are loaded unaligned
+__attribute__((target("sse2"))) float convolveSSE(const float *input, const float *kernel, float fraction) {
+	__m128 sum = _mm_setzero_ps(), nextSum = _mm_setzero_ps();
+	for (int i = 0; i < RESAMPLER_TAPS; i += 4) {
+		const __m128 samples = _mm_loadu_ps(&input[i]);
+		sum = _mm_add_ps(sum, _mm_mul_ps(samples, _mm_loadu_ps(&kernel[i])));
+		nextSum = _mm_add_ps(nextSum, _mm_mul_ps(samples, _mm_loadu_ps(&kernel[RESAMPLER_TAPS + i])));
+	}
+	// Interpolating before the horizontal sum saves one of them
+	return sumLanes(_mm_add_ps(sum, _mm_mul_ps(_mm_sub_ps(nextSum, sum), _mm_set1_ps(fraction))));
+}
+
+__attribute__((target("avx"))) float convolveAVX(const float *input, const float *kernel, float fraction) {
+	__m256 sum = _mm256_setzero_ps(), nextSum = _mm256_setzero_ps();
+	for (int i = 0; i < RESAMPLER_TAPS; i += 8) {
+		const __m256 samples = _mm256_loadu_ps(&input[i]);
+		sum = _mm256_add_ps(sum, _mm256_mul_ps(samples, _mm256_loadu_ps(&kernel[i])));
+		nextSum = _mm256_add_ps(nextSum, _mm256_mul_ps(samples, _mm256_loadu_ps(&kernel[RESAMPLER_TAPS + i])));
+	}
+	const __m256 interpolated = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_sub_ps(nextSum, sum), _mm256_set1_ps(fraction)));
+	return sumLanes(_mm_add_ps(_mm256_castps256_ps128(interpolated), _mm256_extractf128_ps(interpolated, 1)));
+}
+#else
+// Without x86 vector extensions, both paths fall back to scalar code
+float convolveSSE(const float *input, const float *kernel, float fraction) {
+	return convolveScalar(input, kernel, fraction);
+}
+
+float convolveAVX(const float *input, const float *kernel, float fraction) {
+	return convolveScalar(input, kernel, fraction);
+}
+#endif // ifdef RESAMPLE_X86
\ No newline at end of file
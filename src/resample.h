@@ -0,0 +1,41 @@
+#ifndef RESAMPLE_H
+#define RESAMPLE_H
+
+#include <stdint.h>
+
+// Polyphase FIR resampler, from the fixed rate sound is synthesized at to the rate of the audio device
+// Each output sample is the inner product of RESAMPLER_TAPS input samples with a Kaiser-windowed sinc, whose phase is interpolated linearly between the two nearest of RESAMPLER_PHASES precomputed ones
+// The ratio can be changed at any time without rebuilding the kernel, which is what rate control relies on
+#define RESAMPLER_PHASES 256
+#define RESAMPLER_TAPS 64 // Must be a multiple of 8 (the width of an AVX vector); delays the output by RESAMPLER_TAPS / 2 input samples
+#define RESAMPLER_SIZE 8192 // Input samples that can be waiting to be resampled
+#define RESAMPLER_CUTOFF 0.9 // Relative to the lowest of the two Nyquist frequencies, leaving room for the transition band below it
+#define RESAMPLER_BETA 8.0 // Shape of the Kaiser window, trading the width of the transition band for stopband attenuation (about 80 dB)
+
+// Returns the output sample for the input samples in input, filtered by the kernel phase in kernel and the one after it, weighted by fraction
+typedef float (*ConvolveFunction)(const float *input, const float *kernel, float fraction);
+
+typedef struct Resampler {
+	double inputRate;
+	double outputRate;
+	double step; // Input samples per output sample, including the rate adjustment
+	double position; // Position of the next output sample from the start of buffer, in input samples
+
+	ConvolveFunction convolve;
+	uint32_t count; // Input samples in buffer
+	_Alignas(32) float kernel[RESAMPLER_PHASES + 1][RESAMPLER_TAPS]; // The last phase is the first one shifted by a sample, so every phase has a next one to be interpolated with
+	float buffer[RESAMPLER_SIZE];
+} Resampler;
+
+// Interface functions
+ConvolveFunction selectConvolver(void);
+void initResampler(Resampler *resampler, double inputRate, double outputRate);
+void adjustRateResampler(Resampler *resampler, double adjustment);
+void clearResampler(Resampler *resampler);
+uint32_t writeResampler(Resampler *resampler, const float *in, uint32_t count);
+uint32_t readResampler(Resampler *resampler, float *out, uint32_t count);
+float convolveScalar(const float *input, const float *kernel, float fraction);
+float convolveSSE(const float *input, const float *kernel, float fraction);
+float convolveAVX(const float *input, const float *kernel, float fraction);
+
+#endif // ifndef RESAMPLE_H
\ No newline at end of file
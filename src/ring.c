@@ -0,0 +1,81 @@
+#include "ring.h"
+
+
+// Interface functions
+// Entries in the ring, as seen by the producer
+// Acquire makes sure the consumer is done with the entries it popped before the producer overwrites them
+uint32_t ringFill(uint32_t write, const uint32_t *read) {
+	return write - __atomic_load_n(read, __ATOMIC_ACQUIRE);
+}
+
+// Entries in the ring, as seen by the consumer
+// Acquire makes the entries written before the write index was published visible here
+uint32_t ringAvailable(const uint32_t *write, uint32_t read) {
+	return __atomic_load_n(write, __ATOMIC_ACQUIRE) - read;
+}
+
+// Moves either index once the entries before it were written or read
+// Release makes sure the other side can't see the index before the entries
+void publishRing(uint32_t *index, uint32_t value) {
+	__atomic_store_n(index, value, __ATOMIC_RELEASE);
+}
+
+void initRingWaiter(RingWaiter *waiter) {
+	pthread_mutex_init(&waiter->lock, NULL);
+	pthread_cond_init(&waiter->pushed, NULL);
+	pthread_cond_init(&waiter->popped, NULL);
+	waiter->pending = false;
+	waiter->closed = false;
+}
+
+void destroyRingWaiter(RingWaiter *waiter) {
+	pthread_cond_destroy(&waiter->popped);
+	pthread_cond_destroy(&waiter->pushed);
+	pthread_mutex_destroy(&waiter->lock);
+}
+
+// Called by a producer finding its ring full: wakes up the consumer, and sleeps until it made room
+void waitForRoom(RingWaiter *waiter, uint32_t write, const uint32_t *read, uint32_t size) {
+	pthread_mutex_lock(&waiter->lock);
+	waiter->pending = true;
+	pthread_cond_signal(&waiter->pushed);
+	while (ringFill(write, read) == size)
+		pthread_cond_wait(&waiter->popped, &waiter->lock);
+	pthread_mutex_unlock(&waiter->lock);
+}
+
+// Called by the consumer finding its rings empty: sleeps until something may have been pushed, and returns false instead once the rings are closed and there is nothing left to pop
+// Anything pushed before the consumer looked at the rings marks the waiter as pending, so it is never slept through
+bool waitForPush(RingWaiter *waiter) {
+	pthread_mutex_lock(&waiter->lock);
+	while (!waiter->pending && !waiter->closed)
+		pthread_cond_wait(&waiter->pushed, &waiter->lock);
+	const bool pending = waiter->pending;
+	waiter->pending = false;
+	pthread_mutex_unlock(&waiter->lock);
+	return pending;
+}
+
+// Producers don't have to signal every push, only once they want what they pushed to be popped
+void signalPushed(RingWaiter *waiter) {
+	pthread_mutex_lock(&waiter->lock);
+	waiter->pending = true;
+	pthread_cond_signal(&waiter->pushed);
+	pthread_mutex_unlock(&waiter->lock);
+}
+
+// Every producer waiting for room is woken up, as rings sharing the waiter may each have one
+void signalPopped(RingWaiter *waiter) {
+	pthread_mutex_lock(&waiter->lock);
+	pthread_cond_broadcast(&waiter->popped);
+	pthread_mutex_unlock(&waiter->lock);
+}
+
+// Everything pushed before is still popped, so the producers must be done by then
+void closeRing(RingWaiter *waiter) {
+	pthread_mutex_lock(&waiter->lock);
+	waiter->pending = true;
+	waiter->closed = true;
+	pthread_cond_signal(&waiter->pushed);
+	pthread_mutex_unlock(&waiter->lock);
+}
\ No newline at end of file
@@ -0,0 +1,36 @@
+#ifndef RING_H
+#define RING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+// Single-producer, single-consumer rings hand samples, APU register writes and captured frames from one thread to another without locking
+// A ring is an array whose size is a power of two, and a write and a read index
+// Both indices only ever increase (wrapping around at 2^32) and are masked when accessing the ring, so a full ring can be told apart from an empty one
+// Each index is only written by one side and read by the other, and is kept on its own cache line (_Alignas(CACHE_LINE)) so they don't bounce between cores
+#define CACHE_LINE 64
+
+// Lets the consumer sleep until something is pushed, and a producer until something is popped from a full ring
+// Rings with the same consumer can share one
+typedef struct RingWaiter {
+	pthread_mutex_t lock;
+	pthread_cond_t pushed; // Signaled by producers
+	pthread_cond_t popped; // Signaled by the consumer
+	bool pending; // Something may have been pushed since the consumer last woke up
+	bool closed; // Producers are done, and the consumer stops once the rings are empty
+} RingWaiter;
+
+// Interface functions
+uint32_t ringFill(uint32_t write, const uint32_t *read);
+uint32_t ringAvailable(const uint32_t *write, uint32_t read);
+void publishRing(uint32_t *index, uint32_t value);
+void initRingWaiter(RingWaiter *waiter);
+void destroyRingWaiter(RingWaiter *waiter);
+void waitForRoom(RingWaiter *waiter, uint32_t write, const uint32_t *read, uint32_t size);
+bool waitForPush(RingWaiter *waiter);
+void signalPushed(RingWaiter *waiter);
+void signalPopped(RingWaiter *waiter);
+void closeRing(RingWaiter *waiter);
+
+#endif // ifndef RING_H
\ No newline at end of file
@@ -1,8 +1,14 @@
-#version 460
-uniform samplerBuffer texture;
-in flat int colorLocation;
+#version 450
+uniform usampler2D frame;
+uniform sampler2D palette;
+in vec2 framePosition;
 out vec4 finalColor;
 
 void main() {
-	finalColor = vec4(texelFetch(texture, colorLocation).x, texelFetch(texture, colorLocation + 1).x, texelFetch(texture, colorLocation + 2).x, 1.0);
+	ivec2 size = textureSize(frame, 0);
+	ivec2 location = min(ivec2(framePosition * size), size - 1);
+
+	// Each pixel is a color (bits 0-5) with emphasis bits (bits 6-8), which select the row of the palette
+	uint pixel = texelFetch(frame, location, 0).x;
+	finalColor = vec4(texelFetch(palette, ivec2(pixel & 0x3Fu, pixel >> 6), 0).rgb, 1.0);
 }
\ No newline at end of file
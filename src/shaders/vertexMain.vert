@@ -1,8 +1,11 @@
-#version 460
-in vec2 pos;
-out flat int colorLocation;
+#version 450
+out vec2 framePosition;
 
 void main() {
-	gl_Position = vec4(pos.xy, 1.0, 1.0);
-	colorLocation = gl_VertexID / 4 * 3;
+	// A single triangle covers the whole screen, with vertices at (-1, -1), (3, -1) and (-1, 3)
+	vec2 position = vec2((gl_VertexID & 1) * 4 - 1, (gl_VertexID & 2) * 2 - 1);
+	gl_Position = vec4(position, 0.0, 1.0);
+
+	// (0, 0) is the top-left corner of the frame and (1, 1) its bottom-right corner
+	framePosition = vec2(position.x + 1.0, 1.0 - position.y) / 2.0;
 }
\ No newline at end of file
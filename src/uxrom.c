@@ -0,0 +1,42 @@
+#include "mapper.h"
+
+#include "cartridge.h"
+
+// UxROM: a 16KiB PRG bank at 0x8000 selected by writes to ROM space, the last 16KiB fixed at 0xC000, and 8KiB of CHR (usually RAM)
+
+typedef struct UxROMState {
+	uint8_t bank;
+} UxROMState;
+
+
+// Non-interface functions
+void syncUxROM(Cartridge *cart) {
+	const UxROMState *state = cart->mapperState;
+	mapPRG(cart, 0, 2, state->bank << 14);
+	mapPRG(cart, 2, 2, cart->PRGsize - 0x4000);
+}
+
+void initUxROM(Cartridge *cart) {
+	mapCHR(cart, 0, 8, 0x0000);
+	syncUxROM(cart);
+}
+
+void writePRGUxROM(Bus *bus, uint16_t address, uint8_t data) {
+	Cartridge *cart = bus->cartridge;
+	if (address < 0x8000) {
+		writePRGRAM(cart, address, data);
+		return;
+	}
+
+	((UxROMState *)cart->mapperState)->bank = busConflict(cart, address, data);
+	syncUxROM(cart);
+}
+
+
+// Interface functions
+const Mapper uxromMapper = {
+	MAPPER_UXROM, "UxROM", sizeof(UxROMState), false, initUxROM,
+	readPRGBanks, writePRGUxROM, readCHRBanks, writeCHRBanks,
+	NULL, NULL,
+	syncUxROM
+};
\ No newline at end of file